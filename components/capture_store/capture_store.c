@@ -0,0 +1,581 @@
+/**
+ * capture_store.c
+ *
+ * Log-structured record store on a raw partition. Layout, in 4 KB sectors:
+ *
+ *   [index A][index B][data 0][data 1] ... [data N-1]
+ *
+ * Data is addressed by a 64-bit log position that only grows; its flash
+ * offset is the position modulo the data area size. Everything below
+ * erased_end is either written or evicted, so a write never has to look at
+ * what is on flash before it.
+ */
+
+#include "capture_store.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+static const char* TAG = "capture_store";
+
+#define SECTOR          4096
+#define INDEX_SECTORS   2
+#define ENTRY_SIZE      64
+#define SLOTS           (SECTOR / ENTRY_SIZE)   // slot 0 holds the sector header
+#define MIN_DATA_SECTORS 4
+#define ERASED32        0xffffffffu
+#define HEADER_MAGIC    0x31545343u             // "CST1"
+#define ENTRY_MAGIC     0x31434552u             // "REC1"
+#define SCAN_CHUNK      256
+
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;     // highest valid generation is the active index sector
+    uint64_t head;           // log position when the sector was written
+    uint32_t next_id;
+    uint8_t  reserved[ENTRY_SIZE - 20];
+} index_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t id;
+    uint64_t start;          // log position of the first byte
+    uint32_t created;
+    uint8_t  info[CAPTURE_STORE_INFO_LEN];
+    uint32_t length;         // ERASED32 until finished
+    uint32_t result;         // ERASED32 until finished
+    uint32_t deleted;        // ERASED32 while live, 0 once deleted
+} index_entry_t;
+
+_Static_assert(sizeof(index_header_t) == ENTRY_SIZE, "index header must fill one slot");
+_Static_assert(sizeof(index_entry_t) == ENTRY_SIZE, "index entry must fill one slot");
+
+typedef struct {
+    capture_store_record_t rec;
+    uint64_t start;
+    uint32_t slot;           // index slot of the entry
+} live_t;
+
+struct capture_store {
+    const esp_partition_t* part;
+    SemaphoreHandle_t lock;
+    uint64_t data_size;
+    uint32_t index_sector;   // active index sector, 0 or 1
+    uint32_t generation;
+    uint32_t next_slot;
+    uint32_t next_id;
+    uint64_t head;           // log position of the next byte
+    uint64_t erased_end;     // flash is erased from head up to here
+    live_t   live[CAPTURE_STORE_MAX_RECORDS];   // oldest first
+    uint32_t live_count;
+    int      open;           // live[] index of the open record, -1 if none
+};
+
+static inline uint64_t round_up(uint64_t pos)
+{
+    return (pos + SECTOR - 1) & ~(uint64_t)(SECTOR - 1);
+}
+
+static inline size_t entry_offset(const capture_store_t* s, uint32_t slot)
+{
+    return s->index_sector * SECTOR + slot * ENTRY_SIZE;
+}
+
+static inline size_t data_offset(const capture_store_t* s, uint64_t pos)
+{
+    return INDEX_SECTORS * SECTOR + (size_t)(pos % s->data_size);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Flash access (data areas wrap at the end of the partition)
+
+static esp_err_t data_io(capture_store_t* s, uint64_t pos, void* buf, size_t len, bool write)
+{
+    while (len > 0) {
+        size_t off = data_offset(s, pos);
+        size_t n = INDEX_SECTORS * SECTOR + s->data_size - off;
+        if (n > len) {
+            n = len;
+        }
+        esp_err_t err = write ? esp_partition_write(s->part, off, buf, n)
+                              : esp_partition_read(s->part, off, buf, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        pos += n;
+        buf = (uint8_t*)buf + n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t program_entry_field(capture_store_t* s, uint32_t slot, size_t field,
+                                     const void* value, size_t len)
+{
+    return esp_partition_write(s->part, entry_offset(s, slot) + field, value, len);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Live record table
+
+static live_t* find_live(capture_store_t* s, uint32_t id)
+{
+    for (uint32_t i = 0; i < s->live_count; i++) {
+        if (s->live[i].rec.id == id) {
+            return &s->live[i];
+        }
+    }
+    return NULL;
+}
+
+static void drop_live(capture_store_t* s, uint32_t i)
+{
+    memmove(&s->live[i], &s->live[i + 1], (s->live_count - i - 1) * sizeof(live_t));
+    s->live_count--;
+    if (s->open == (int)i) {
+        s->open = -1;
+    } else if (s->open > (int)i) {
+        s->open--;
+    }
+}
+
+// Mark the entry deleted on flash and forget it
+static void delete_live(capture_store_t* s, uint32_t i)
+{
+    static const uint32_t zero = 0;
+    program_entry_field(s, s->live[i].slot, offsetof(index_entry_t, deleted), &zero, sizeof(zero));
+    drop_live(s, i);
+}
+
+/**
+ * @brief Erase data sectors until flash is clean up to `end`, evicting the
+ *        records whose bytes share those sectors from the previous lap.
+ */
+static esp_err_t ensure_erased(capture_store_t* s, uint64_t end)
+{
+    while (s->erased_end < end) {
+        // The sector at erased_end holds log bytes [erased_end - data_size, +SECTOR)
+        uint64_t reused_end = s->erased_end + SECTOR;
+        while (s->live_count > 0 && s->live[0].start + s->data_size < reused_end &&
+               s->open != 0) {
+            ESP_LOGI(TAG, "Evicting record %u", (unsigned)s->live[0].rec.id);
+            delete_live(s, 0);
+        }
+        esp_err_t err = esp_partition_erase_range(s->part, data_offset(s, s->erased_end), SECTOR);
+        if (err != ESP_OK) {
+            return err;
+        }
+        s->erased_end += SECTOR;
+    }
+    return ESP_OK;
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Index sectors
+
+static esp_err_t write_header(capture_store_t* s)
+{
+    index_header_t hdr;
+    memset(&hdr, 0xff, sizeof(hdr));
+    hdr.magic = HEADER_MAGIC;
+    hdr.generation = s->generation;
+    hdr.head = s->head;
+    hdr.next_id = s->next_id;
+    return esp_partition_write(s->part, s->index_sector * SECTOR, &hdr, sizeof(hdr));
+}
+
+static void fill_entry(index_entry_t* e, const live_t* l)
+{
+    memset(e, 0xff, sizeof(*e));
+    e->magic = ENTRY_MAGIC;
+    e->id = l->rec.id;
+    e->start = l->start;
+    e->created = l->rec.created;
+    memcpy(e->info, l->rec.info, CAPTURE_STORE_INFO_LEN);
+    if (!l->rec.open) {
+        e->length = l->rec.length;
+        e->result = l->rec.result;
+    }
+}
+
+/**
+ * @brief Rewrite the live entries into the other index sector; the header goes
+ *        last, so a reset midway leaves the old sector active.
+ */
+static esp_err_t compact_index(capture_store_t* s)
+{
+    uint32_t target = s->index_sector ^ 1;
+    esp_err_t err = esp_partition_erase_range(s->part, target * SECTOR, SECTOR);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (uint32_t i = 0; i < s->live_count; i++) {
+        index_entry_t e;
+        fill_entry(&e, &s->live[i]);
+        err = esp_partition_write(s->part, target * SECTOR + (i + 1) * ENTRY_SIZE, &e, sizeof(e));
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    for (uint32_t i = 0; i < s->live_count; i++) {
+        s->live[i].slot = i + 1;
+    }
+    s->index_sector = target;
+    s->generation++;
+    s->next_slot = s->live_count + 1;
+    ESP_LOGI(TAG, "Index compacted into sector %u (%u records)", (unsigned)target, (unsigned)s->live_count);
+    return write_header(s);
+}
+
+static esp_err_t format(capture_store_t* s)
+{
+    ESP_LOGW(TAG, "No valid index on \"%s\", formatting", s->part->label);
+    esp_err_t err = esp_partition_erase_range(s->part, 0, INDEX_SECTORS * SECTOR);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s->index_sector = 0;
+    s->generation = 1;
+    s->next_slot = 1;
+    s->next_id = 1;
+    s->head = 0;
+    return write_header(s);
+}
+
+/**
+ * @brief Find where an interrupted record's data ends: the last byte that is
+ *        not erased before the first fully erased sector.
+ */
+static uint32_t recover_length(capture_store_t* s, uint64_t start)
+{
+    uint8_t buf[SCAN_CHUNK];
+    uint64_t end = start;
+    uint64_t limit = start + s->data_size - 2 * SECTOR;
+    for (uint64_t sec = start; sec < limit; sec += SECTOR) {
+        bool erased = true;
+        for (uint32_t off = 0; off < SECTOR; off += SCAN_CHUNK) {
+            if (data_io(s, sec + off, buf, SCAN_CHUNK, false) != ESP_OK) {
+                return (uint32_t)(end - start);
+            }
+            for (int i = SCAN_CHUNK - 1; i >= 0; i--) {
+                if (buf[i] != 0xff) {
+                    end = sec + off + i + 1;
+                    erased = false;
+                    break;
+                }
+            }
+        }
+        if (erased) {
+            break;   // the write position kept this sector erased ahead
+        }
+    }
+    return (uint32_t)(end - start);
+}
+
+static esp_err_t load_index(capture_store_t* s, uint64_t header_head)
+{
+    s->head = header_head;
+    s->next_slot = SLOTS;
+    for (uint32_t slot = 1; slot < SLOTS; slot++) {
+        index_entry_t e;
+        esp_err_t err = esp_partition_read(s->part, entry_offset(s, slot), &e, sizeof(e));
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (e.magic == ERASED32) {
+            s->next_slot = slot;   // entries are appended in order
+            break;
+        }
+        if (e.magic != ENTRY_MAGIC) {
+            continue;              // torn write
+        }
+        if (e.id >= s->next_id) {
+            s->next_id = e.id + 1;
+        }
+        if (e.length == ERASED32 && e.deleted == ERASED32) {
+            // Open when the device reset: close it with what reached flash
+            e.length = recover_length(s, e.start);
+            e.result = CAPTURE_STORE_RESULT_RECOVERED;
+            program_entry_field(s, slot, offsetof(index_entry_t, length), &e.length, 8);
+            ESP_LOGW(TAG, "Recovered interrupted record %u (%u bytes)", (unsigned)e.id, (unsigned)e.length);
+        }
+        uint64_t end = e.start + (e.length == ERASED32 ? 0 : e.length);
+        if (end > s->head) {
+            s->head = end;
+        }
+        if (e.deleted != ERASED32) {
+            continue;
+        }
+        if (s->live_count == CAPTURE_STORE_MAX_RECORDS) {
+            delete_live(s, 0);
+        }
+        live_t* l = &s->live[s->live_count++];
+        l->start = e.start;
+        l->slot = slot;
+        l->rec.id = e.id;
+        l->rec.length = e.length;
+        l->rec.created = e.created;
+        l->rec.result = e.result;
+        l->rec.open = false;
+        memcpy(l->rec.info, e.info, CAPTURE_STORE_INFO_LEN);
+    }
+
+    // Bytes after head in its sector are erased; anything a full lap behind is gone
+    s->erased_end = round_up(s->head);
+    while (s->live_count > 0 && s->live[0].start + s->data_size < s->erased_end) {
+        delete_live(s, 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t capture_store_mount(const char* label, capture_store_t** out)
+{
+    const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!part) {
+        ESP_LOGE(TAG, "Partition \"%s\" not found", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (part->size < (INDEX_SECTORS + MIN_DATA_SECTORS) * SECTOR) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    capture_store_t* s = calloc(1, sizeof(*s));
+    if (!s) {
+        return ESP_ERR_NO_MEM;
+    }
+    s->lock = xSemaphoreCreateMutex();
+    if (!s->lock) {
+        free(s);
+        return ESP_ERR_NO_MEM;
+    }
+    s->part = part;
+    s->data_size = (uint64_t)(part->size / SECTOR - INDEX_SECTORS) * SECTOR;
+    s->open = -1;
+
+    // The valid header with the highest generation marks the active index sector
+    index_header_t hdr[INDEX_SECTORS];
+    int active = -1;
+    for (int i = 0; i < INDEX_SECTORS; i++) {
+        if (esp_partition_read(part, i * SECTOR, &hdr[i], sizeof(hdr[i])) == ESP_OK &&
+            hdr[i].magic == HEADER_MAGIC && hdr[i].generation != ERASED32 &&
+            (active < 0 || hdr[i].generation > hdr[active].generation)) {
+            active = i;
+        }
+    }
+
+    esp_err_t err;
+    if (active < 0) {
+        err = format(s);
+        s->erased_end = 0;
+    } else {
+        s->index_sector = active;
+        s->generation = hdr[active].generation;
+        s->next_id = hdr[active].next_id;
+        err = load_index(s, hdr[active].head);
+    }
+    if (err != ESP_OK) {
+        vSemaphoreDelete(s->lock);
+        free(s);
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Mounted \"%s\": %u KB log, %u records, head %llu",
+             part->label, (unsigned)(s->data_size / 1024), (unsigned)s->live_count,
+             (unsigned long long)s->head);
+    *out = s;
+    return ESP_OK;
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Records
+
+esp_err_t capture_store_begin(capture_store_t* s, const void* info, uint32_t created, uint32_t* out_id)
+{
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    if (s->open >= 0) {
+        err = ESP_ERR_INVALID_STATE;
+        goto out;
+    }
+    if (s->next_slot >= SLOTS && (err = compact_index(s)) != ESP_OK) {
+        goto out;
+    }
+    if (s->live_count == CAPTURE_STORE_MAX_RECORDS) {
+        delete_live(s, 0);
+    }
+
+    // Records start on a sector boundary: full-buffer appends are then whole sectors
+    uint64_t start = round_up(s->head);
+    if ((err = ensure_erased(s, start + SECTOR)) != ESP_OK) {
+        goto out;
+    }
+
+    live_t* l = &s->live[s->live_count];
+    memset(l, 0, sizeof(*l));
+    l->start = start;
+    l->slot = s->next_slot;
+    l->rec.id = s->next_id;
+    l->rec.created = created;
+    l->rec.result = CAPTURE_STORE_RESULT_NONE;
+    l->rec.open = true;
+    if (info) {
+        memcpy(l->rec.info, info, CAPTURE_STORE_INFO_LEN);
+    }
+
+    index_entry_t e;
+    fill_entry(&e, l);
+    if ((err = esp_partition_write(s->part, entry_offset(s, l->slot), &e, sizeof(e))) != ESP_OK) {
+        goto out;
+    }
+    s->next_slot++;
+    s->next_id++;
+    s->head = start;
+    s->open = s->live_count++;
+    *out_id = l->rec.id;
+
+out:
+    xSemaphoreGive(s->lock);
+    return err;
+}
+
+esp_err_t capture_store_reserve(capture_store_t* s, size_t bytes)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    // Same bound ensure_erased() evicts at once the record and its erase-ahead sector are in place
+    uint64_t end = round_up(round_up(s->head) + bytes) + SECTOR;
+    while (s->live_count > 0 && s->live[0].start + s->data_size < end && s->open != 0) {
+        ESP_LOGI(TAG, "Evicting record %u to reserve %u bytes",
+                 (unsigned)s->live[0].rec.id, (unsigned)bytes);
+        delete_live(s, 0);
+    }
+    xSemaphoreGive(s->lock);
+    return bytes > s->data_size - 2 * SECTOR ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+esp_err_t capture_store_append(capture_store_t* s, const void* data, size_t len)
+{
+    esp_err_t err;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    if (s->open < 0) {
+        err = ESP_ERR_INVALID_STATE;
+        goto out;
+    }
+    live_t* l = &s->live[s->open];
+    // Leave room for the erase-ahead sector so the record never evicts itself
+    if (s->head + len - l->start > s->data_size - 2 * SECTOR) {
+        err = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    // Keep the sector after the write position erased ahead of time
+    if ((err = ensure_erased(s, s->head + len + SECTOR)) != ESP_OK) {
+        goto out;
+    }
+    l = &s->live[s->open];   // eviction may have shifted the table
+    if ((err = data_io(s, s->head, (void*)data, len, true)) != ESP_OK) {
+        goto out;
+    }
+    s->head += len;
+    l->rec.length += len;
+
+out:
+    xSemaphoreGive(s->lock);
+    return err;
+}
+
+esp_err_t capture_store_finish(capture_store_t* s, uint32_t result)
+{
+    esp_err_t err;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    if (s->open < 0) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        live_t* l = &s->live[s->open];
+        uint32_t fields[2] = { l->rec.length, result };
+        err = program_entry_field(s, l->slot, offsetof(index_entry_t, length), fields, sizeof(fields));
+        l->rec.result = result;
+        l->rec.open = false;
+        s->open = -1;
+    }
+    xSemaphoreGive(s->lock);
+    return err;
+}
+
+bool capture_store_stat(capture_store_t* s, uint32_t id, capture_store_record_t* out)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    live_t* l = find_live(s, id);
+    if (l) {
+        *out = l->rec;
+    }
+    xSemaphoreGive(s->lock);
+    return l != NULL;
+}
+
+size_t capture_store_list(capture_store_t* s, capture_store_record_t* out, size_t max)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    size_t n = s->live_count < max ? s->live_count : max;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = s->live[i].rec;
+    }
+    xSemaphoreGive(s->lock);
+    return n;
+}
+
+bool capture_store_newest(capture_store_t* s, capture_store_record_t* out)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    bool found = s->live_count > 0;
+    if (found) {
+        *out = s->live[s->live_count - 1].rec;
+    }
+    xSemaphoreGive(s->lock);
+    return found;
+}
+
+ssize_t capture_store_read(capture_store_t* s, uint32_t id, size_t offset, void* buf, size_t len)
+{
+    ssize_t ret = -1;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    live_t* l = find_live(s, id);
+    if (l) {
+        if (offset >= l->rec.length) {
+            ret = 0;
+        } else {
+            if (len > l->rec.length - offset) {
+                len = l->rec.length - offset;
+            }
+            ret = data_io(s, l->start + offset, buf, len, false) == ESP_OK ? (ssize_t)len : -1;
+        }
+    }
+    xSemaphoreGive(s->lock);
+    return ret;
+}
+
+esp_err_t capture_store_delete(capture_store_t* s, uint32_t id)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    live_t* l = find_live(s, id);
+    if (l && l->rec.open) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (l) {
+        delete_live(s, l - s->live);
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s->lock);
+    return err;
+}
+
+void capture_store_usage(capture_store_t* s, size_t* used, size_t* total)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    *used = s->live_count ? (size_t)(round_up(s->head) - s->live[0].start) : 0;
+    *total = (size_t)s->data_size;
+    xSemaphoreGive(s->lock);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Append-only capture store on a raw data partition.
+ *
+ * The partition is a circular log of flash sectors preceded by two index
+ * sectors. Each capture is one record: it starts on a sector boundary and
+ * its bytes are appended in order, so an append is a single flash write with
+ * no filesystem metadata behind it. The sector after the write position is
+ * kept erased ahead of time; when the log wraps, the oldest records are
+ * evicted sector by sector.
+ *
+ * The index holds one 64-byte entry per record, programmed in place (flash
+ * bits only go from 1 to 0): created when the record begins, completed with
+ * its length when it finishes, cleared when it is deleted. When an index
+ * sector fills, the live entries are compacted into the other one. A record
+ * left open by a reset is closed at mount with the data found on flash.
+ *
+ * One record can be open for writing at a time; reads, listing and deletion
+ * are safe from other tasks meanwhile.
+ */
+
+#define CAPTURE_STORE_INFO_LEN        32           // caller metadata bytes per record
+#define CAPTURE_STORE_MAX_RECORDS     32           // live records tracked at once
+#define CAPTURE_STORE_RESULT_NONE     0xffffffff   // record still open
+#define CAPTURE_STORE_RESULT_RECOVERED 0xfffffffe  // record closed at mount after a reset
+
+typedef struct capture_store capture_store_t;
+
+typedef struct {
+    uint32_t id;                             // increasing, never reused
+    uint32_t length;                         // bytes of data (so far, while open)
+    uint32_t created;                        // caller timestamp given to begin()
+    uint32_t result;                         // caller value given to finish()
+    bool     open;                           // still being written
+    uint8_t  info[CAPTURE_STORE_INFO_LEN];   // caller metadata given to begin()
+} capture_store_record_t;
+
+/**
+ * @brief Mount the store on the data partition with the given label, formatting it
+ *        if it holds no valid index.
+ */
+esp_err_t capture_store_mount(const char* label, capture_store_t** out);
+
+/**
+ * @brief Start a new record at the next sector boundary.
+ * @param info    CAPTURE_STORE_INFO_LEN bytes of caller metadata, or NULL.
+ * @param created Caller timestamp stored with the record.
+ * @return ESP_ERR_INVALID_STATE if a record is already open.
+ */
+esp_err_t capture_store_begin(capture_store_t* store, const void* info, uint32_t created,
+                              uint32_t* out_id);
+
+/**
+ * @brief Evict the oldest records until a new record of `bytes` fits without
+ *        evicting anything while it is written.
+ * @return ESP_ERR_INVALID_SIZE if `bytes` exceeds what the log can hold at all
+ *         (records are still evicted to make as much room as possible).
+ */
+esp_err_t capture_store_reserve(capture_store_t* store, size_t bytes);
+
+/**
+ * @brief Append to the open record. O(1): one flash write, plus one sector erase
+ *        each time the write position enters a new sector.
+ * @return ESP_ERR_NO_MEM once the record would not fit in the log.
+ */
+esp_err_t capture_store_append(capture_store_t* store, const void* data, size_t len);
+
+/**
+ * @brief Close the open record and store a caller-defined result word with it.
+ */
+esp_err_t capture_store_finish(capture_store_t* store, uint32_t result);
+
+/**
+ * @brief Look up a record.
+ * @return false if the id is unknown, deleted or evicted.
+ */
+bool capture_store_stat(capture_store_t* store, uint32_t id, capture_store_record_t* out);
+
+/**
+ * @brief Copy up to `max` records, oldest first.
+ * @return Number of records copied.
+ */
+size_t capture_store_list(capture_store_t* store, capture_store_record_t* out, size_t max);
+
+/**
+ * @brief Most recently begun record that is still live.
+ * @return false if the store is empty.
+ */
+bool capture_store_newest(capture_store_t* store, capture_store_record_t* out);
+
+/**
+ * @brief Read record bytes starting at offset.
+ * @return Bytes read (0 at the end of the record), or -1 if the record is gone.
+ */
+ssize_t capture_store_read(capture_store_t* store, uint32_t id, size_t offset, void* buf, size_t len);
+
+/**
+ * @brief Delete a finished record. Its space is reclaimed when the log wraps.
+ */
+esp_err_t capture_store_delete(capture_store_t* store, uint32_t id);
+
+/**
+ * @brief Log size and bytes currently held by live records (sector-rounded).
+ */
+void capture_store_usage(capture_store_t* store, size_t* used, size_t* total);
+
+#ifdef __cplusplus
+}
+#endif
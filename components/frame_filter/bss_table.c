@@ -0,0 +1,363 @@
+/**
+ * bss_table.c
+ *
+ * Passive BSS / station table. Both sets share the same slot layout (MAC key
+ * at offset 0, used flag right after it), so probing, insertion and removal
+ * are written once over raw slot bytes.
+ */
+
+#include "bss_table.h"
+#include "ieee80211.h"
+#include <string.h>
+#include <stddef.h>
+
+#define IE_DS_PARAMS   3
+#define IE_RSN         48
+#define IE_VENDOR      221
+#define CAP_PRIVACY    0x0010
+
+#define RSSI_EWMA_SHIFT  3    // new sample weighs 1/8
+#define EVICT_SAMPLE     8    // entries compared per eviction
+
+_Static_assert(offsetof(bss_entry_t, used) == 6 && offsetof(bss_station_t, used) == 6,
+               "slot layout: 6-byte key, then the used flag");
+
+#define SLOT(base, size, i)  ((uint8_t*)(base) + (size_t)(i) * (size))
+
+static inline uint32_t mac_hash(const uint8_t* mac)
+{
+    // Same idea as frame_filter: the NIC-specific half carries the entropy
+    uint32_t h = ((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5]) *
+                 2654435761u;
+    return h ^ (h >> 16);
+}
+
+static int32_t slot_find(void* base, size_t size, uint32_t mask, const uint8_t* key)
+{
+    for (uint32_t i = mac_hash(key) & mask;; i = (i + 1) & mask) {
+        uint8_t* s = SLOT(base, size, i);
+        if (!s[6]) {
+            return -1;
+        }
+        if (memcmp(s, key, 6) == 0) {
+            return (int32_t)i;
+        }
+    }
+}
+
+// The caller guarantees a free slot (entries are capped below the slot count)
+static uint8_t* slot_insert(void* base, size_t size, uint32_t mask, const uint8_t* key)
+{
+    uint32_t i = mac_hash(key) & mask;
+    while (SLOT(base, size, i)[6]) {
+        i = (i + 1) & mask;
+    }
+    uint8_t* s = SLOT(base, size, i);
+    memset(s, 0, size);
+    memcpy(s, key, 6);
+    s[6] = 1;
+    return s;
+}
+
+// Backward-shift deletion: pull later members of the probe chain into the hole
+static void slot_remove(void* base, size_t size, uint32_t mask, uint32_t hole)
+{
+    for (uint32_t j = (hole + 1) & mask;; j = (j + 1) & mask) {
+        uint8_t* s = SLOT(base, size, j);
+        if (!s[6]) {
+            break;
+        }
+        uint32_t home = mac_hash(s) & mask;
+        // Entries whose home lies cyclically in (hole, j] are already as close as they can get
+        bool stays = (hole <= j) ? (hole < home && home <= j) : (hole < home || home <= j);
+        if (!stays) {
+            memcpy(SLOT(base, size, hole), s, size);
+            hole = j;
+        }
+    }
+    SLOT(base, size, hole)[6] = 0;
+}
+
+// Eviction from a full set: the stalest of the next EVICT_SAMPLE entries after the
+// clock hand, which then moves past them. A full set is about half occupied, so
+// this reads ~2 * EVICT_SAMPLE slots however large the table is (it runs in the RX
+// path, under the cache's spinlock), and the hand still sweeps every entry in turn.
+static uint32_t slot_victim(void* base, size_t size, size_t seen_off, uint32_t mask, uint32_t* hand)
+{
+    uint32_t victim = 0, sampled = 0, i = *hand;
+    int64_t oldest_us = INT64_MAX;
+    for (uint32_t n = 0; n <= mask && sampled < EVICT_SAMPLE; n++, i = (i + 1) & mask) {
+        const uint8_t* s = SLOT(base, size, i);
+        if (!s[6]) {
+            continue;
+        }
+        int64_t seen_us;
+        memcpy(&seen_us, s + seen_off, sizeof(seen_us));
+        if (seen_us < oldest_us) {
+            victim = i;
+            oldest_us = seen_us;
+        }
+        sampled++;
+    }
+    *hand = i;
+    return victim;
+}
+
+uint32_t bss_table_slots(uint32_t max)
+{
+    uint32_t n = 4;
+    while (n < 2 * max) {
+        n <<= 1;
+    }
+    return n;
+}
+
+void bss_table_init(bss_table_t* t, bss_entry_t* bss, uint32_t bss_max,
+                    bss_station_t* sta, uint32_t sta_max)
+{
+    memset(t, 0, sizeof(*t));
+    t->bss = bss;
+    t->bss_mask = bss_table_slots(bss_max) - 1;
+    t->bss_max = bss_max;
+    t->sta = sta;
+    t->sta_mask = bss_table_slots(sta_max) - 1;
+    t->sta_max = sta_max;
+}
+
+static void rssi_ewma(int16_t* avg, int8_t rssi)
+{
+    int16_t sample = (int16_t)(rssi * 16);
+    *avg = (*avg == 0) ? sample : (int16_t)(*avg + ((sample - *avg) >> RSSI_EWMA_SHIFT));
+}
+
+static bss_entry_t* bss_get(bss_table_t* t, const uint8_t* bssid)
+{
+    int32_t i = slot_find(t->bss, sizeof(bss_entry_t), t->bss_mask, bssid);
+    if (i >= 0) {
+        return &t->bss[i];
+    }
+    if (t->bss_count >= t->bss_max) {
+        uint32_t oldest = slot_victim(t->bss, sizeof(bss_entry_t), offsetof(bss_entry_t, last_seen_us),
+                                      t->bss_mask, &t->bss_hand);
+        slot_remove(t->bss, sizeof(bss_entry_t), t->bss_mask, oldest);
+        t->bss_count--;
+        t->evictions++;
+    }
+    t->bss_count++;
+    return (bss_entry_t*)slot_insert(t->bss, sizeof(bss_entry_t), t->bss_mask, bssid);
+}
+
+static bss_station_t* sta_get(bss_table_t* t, const uint8_t* mac)
+{
+    int32_t i = slot_find(t->sta, sizeof(bss_station_t), t->sta_mask, mac);
+    if (i >= 0) {
+        return &t->sta[i];
+    }
+    if (t->sta_count >= t->sta_max) {
+        uint32_t oldest = slot_victim(t->sta, sizeof(bss_station_t), offsetof(bss_station_t, last_seen_us),
+                                      t->sta_mask, &t->sta_hand);
+        slot_remove(t->sta, sizeof(bss_station_t), t->sta_mask, oldest);
+        t->sta_count--;
+        t->evictions++;
+    }
+    t->sta_count++;
+    return (bss_station_t*)slot_insert(t->sta, sizeof(bss_station_t), t->sta_mask, mac);
+}
+
+// Walk an RSN element's AKM list: 1/3/5 = 802.1X, 2/4/6 = PSK, 8/9 = SAE
+static bss_auth_t rsn_auth(const uint8_t* ie, uint8_t len)
+{
+    bool psk = false, sae = false, eap = false;
+    uint32_t off = 2 + 4;   // version, group cipher
+    if (off + 2 > len) {
+        return BSS_AUTH_WPA2;
+    }
+    off += 2 + 4u * (ie[off] | ie[off + 1] << 8);   // pairwise cipher list
+    if (off + 2 > len) {
+        return BSS_AUTH_WPA2;
+    }
+    uint32_t n = ie[off] | ie[off + 1] << 8;
+    off += 2;
+    for (uint32_t i = 0; i < n && off + 4 <= len; i++, off += 4) {
+        if (ie[off] != 0x00 || ie[off + 1] != 0x0f || ie[off + 2] != 0xac) {
+            continue;
+        }
+        switch (ie[off + 3]) {
+        case 1: case 3: case 5: eap = true; break;
+        case 2: case 4: case 6: psk = true; break;
+        case 8: case 9:         sae = true; break;
+        default: break;
+        }
+    }
+    if (sae) {
+        return psk ? BSS_AUTH_WPA2_WPA3 : BSS_AUTH_WPA3;
+    }
+    return (eap && !psk) ? BSS_AUTH_WPA2_ENTERPRISE : BSS_AUTH_WPA2;
+}
+
+static void parse_beacon(bss_entry_t* e, const uint8_t* f, uint32_t len, uint8_t rx_channel)
+{
+    uint32_t off = IEEE80211_HDR_LEN + IEEE80211_BEACON_FIXED_LEN;
+    uint16_t cap = f[off - 2] | f[off - 1] << 8;
+    uint8_t channel = 0;
+    bss_auth_t rsn = BSS_AUTH_UNKNOWN;
+    bool wpa = false;
+
+    while (off + 2 <= len) {
+        uint8_t id = f[off], ie_len = f[off + 1];
+        const uint8_t* ie = f + off + 2;
+        if (off + 2 + ie_len > len) {
+            break;
+        }
+        switch (id) {
+        case IEEE80211_IE_SSID:
+            // Keep a name learned earlier when this frame hides it
+            if (ie_len > 0 && ie_len <= sizeof(e->ssid) && ie[0] != 0) {
+                memcpy(e->ssid, ie, ie_len);
+                e->ssid_len = ie_len;
+            }
+            break;
+        case IE_DS_PARAMS:
+            if (ie_len == 1) {
+                channel = ie[0];
+            }
+            break;
+        case IE_RSN:
+            rsn = rsn_auth(ie, ie_len);
+            break;
+        case IE_VENDOR:
+            if (ie_len >= 4 && ie[0] == 0x00 && ie[1] == 0x50 && ie[2] == 0xf2 && ie[3] == 0x01) {
+                wpa = true;
+            }
+            break;
+        default:
+            break;
+        }
+        off += 2 + ie_len;
+    }
+
+    // Off-channel beacons leak in; the DS element is authoritative when present
+    e->channel = channel ? channel : rx_channel;
+    if (rsn != BSS_AUTH_UNKNOWN) {
+        e->auth = (wpa && rsn == BSS_AUTH_WPA2) ? BSS_AUTH_WPA_WPA2 : rsn;
+    } else if (wpa) {
+        e->auth = BSS_AUTH_WPA;
+    } else {
+        e->auth = (cap & CAP_PRIVACY) ? BSS_AUTH_WEP : BSS_AUTH_OPEN;
+    }
+}
+
+void bss_table_observe(bss_table_t* t, const uint8_t* frame, uint32_t len,
+                       int8_t rssi, uint8_t channel, int64_t now_us)
+{
+    if (len < IEEE80211_HDR_LEN) {
+        return;
+    }
+    uint8_t type = IEEE80211_FC0_TYPE(frame[0]);
+
+    if (type == IEEE80211_TYPE_MGMT) {
+        uint8_t subtype = IEEE80211_FC0_SUBTYPE(frame[0]);
+        const uint8_t* bssid = ieee80211_addr3(frame);
+        if ((subtype != IEEE80211_SUBTYPE_BEACON && subtype != IEEE80211_SUBTYPE_PROBE_RESP) ||
+            len < IEEE80211_HDR_LEN + IEEE80211_BEACON_FIXED_LEN || (bssid[0] & 0x01)) {
+            return;
+        }
+        bss_entry_t* e = bss_get(t, bssid);
+        e->beacons++;
+        e->frames++;
+        rssi_ewma(&e->rssi_x16, rssi);
+        parse_beacon(e, frame, len, channel);
+        e->last_seen_us = now_us;
+        return;
+    }
+    if (type != IEEE80211_TYPE_DATA) {
+        return;
+    }
+
+    const uint8_t *bssid, *mac;
+    bool from_sta;
+    switch (frame[1] & (IEEE80211_FC1_TODS | IEEE80211_FC1_FROMDS)) {
+    case IEEE80211_FC1_TODS:
+        bssid = ieee80211_addr1(frame);
+        mac = ieee80211_addr2(frame);
+        from_sta = true;
+        break;
+    case IEEE80211_FC1_FROMDS:
+        bssid = ieee80211_addr2(frame);
+        mac = ieee80211_addr1(frame);
+        from_sta = false;
+        break;
+    default:
+        return;   // IBSS and WDS frames say nothing about AP membership
+    }
+    if (bssid[0] & 0x01) {
+        return;
+    }
+
+    bss_entry_t* e = bss_get(t, bssid);
+    e->frames++;
+    if (!from_sta) {
+        rssi_ewma(&e->rssi_x16, rssi);
+    }
+    if (e->channel == 0) {
+        e->channel = channel;
+    }
+    e->last_seen_us = now_us;
+
+    if (mac[0] & 0x01) {
+        return;   // group-addressed downlink
+    }
+    bss_station_t* s = sta_get(t, mac);
+    memcpy(s->bssid, bssid, 6);
+    s->frames++;
+    if (from_sta) {
+        rssi_ewma(&s->rssi_x16, rssi);
+    }
+    s->last_seen_us = now_us;
+}
+
+void bss_table_add(bss_table_t* t, const uint8_t bssid[6], const uint8_t* ssid, uint8_t ssid_len,
+                   uint8_t channel, int8_t rssi, bss_auth_t auth, int64_t now_us)
+{
+    bss_entry_t* e = bss_get(t, bssid);
+    if (ssid_len > 0 && ssid_len <= sizeof(e->ssid) && ssid[0] != 0) {
+        memcpy(e->ssid, ssid, ssid_len);
+        e->ssid_len = ssid_len;
+    }
+    e->channel = channel;
+    e->auth = auth;
+    rssi_ewma(&e->rssi_x16, rssi);
+    e->last_seen_us = now_us;
+}
+
+void bss_table_expire(bss_table_t* t, int64_t cutoff_us)
+{
+    // A removal can shift a later entry into slot i, so i is re-examined
+    for (uint32_t i = 0; i <= t->bss_mask;) {
+        if (t->bss[i].used && t->bss[i].last_seen_us < cutoff_us) {
+            slot_remove(t->bss, sizeof(bss_entry_t), t->bss_mask, i);
+            t->bss_count--;
+        } else {
+            i++;
+        }
+    }
+    for (uint32_t i = 0; i <= t->sta_mask;) {
+        if (t->sta[i].used && t->sta[i].last_seen_us < cutoff_us) {
+            slot_remove(t->sta, sizeof(bss_station_t), t->sta_mask, i);
+            t->sta_count--;
+        } else {
+            i++;
+        }
+    }
+}
+
+uint32_t bss_table_station_count(const bss_table_t* t, const uint8_t bssid[6])
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i <= t->sta_mask; i++) {
+        if (t->sta[i].used && memcmp(t->sta[i].bssid, bssid, 6) == 0) {
+            n++;
+        }
+    }
+    return n;
+}
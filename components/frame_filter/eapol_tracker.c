@@ -0,0 +1,126 @@
+/**
+ * eapol_tracker.c
+ *
+ * EAPOL-Key parsing and per-(AP, STA, replay counter) message grouping.
+ */
+
+#include "eapol_tracker.h"
+#include "ieee80211.h"
+#include <string.h>
+
+// Offsets from the 802.1X header
+#define EAPOL_OFF_BODY_LEN   2
+#define EAPOL_OFF_KEY_INFO   5
+#define EAPOL_OFF_REPLAY     9
+#define EAPOL_OFF_NONCE      17
+#define EAPOL_OFF_MIC        81
+#define EAPOL_OFF_KD_LEN     97
+#define EAPOL_OFF_KEY_DATA   99
+
+#define KEY_INFO_PAIRWISE    0x0008
+#define KEY_INFO_ACK         0x0080
+#define KEY_INFO_MIC         0x0100
+#define KEY_INFO_SECURE      0x0200
+
+static inline uint16_t be16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+bool eapol_parse(const uint8_t* frame, uint32_t len, eapol_key_t* out)
+{
+    uint32_t avail;
+    const uint8_t* e = ieee80211_eapol_key(frame, len, &avail);
+    if (!e) {
+        return false;
+    }
+
+    uint16_t key_info = be16(e + EAPOL_OFF_KEY_INFO);
+    if (!(key_info & KEY_INFO_PAIRWISE)) {
+        return false;   // group key handshake
+    }
+
+    uint32_t eapol_len = EAPOL_HDR_LEN + be16(e + EAPOL_OFF_BODY_LEN);
+    uint16_t kd_len = be16(e + EAPOL_OFF_KD_LEN);
+    if (eapol_len > avail || EAPOL_OFF_KEY_DATA + (uint32_t)kd_len > eapol_len) {
+        return false;   // truncated by snaplen or malformed
+    }
+
+    uint8_t msg;
+    if (key_info & KEY_INFO_ACK) {
+        msg = (key_info & KEY_INFO_MIC) ? 3 : 1;
+    } else if (!(key_info & KEY_INFO_MIC)) {
+        return false;
+    } else {
+        // M2 carries the supplicant RSN IE; M4 is empty (and Secure on WPA2)
+        msg = ((key_info & KEY_INFO_SECURE) || kd_len == 0) ? 4 : 2;
+    }
+
+    const uint8_t* tx = ieee80211_addr2(frame);
+    const uint8_t* rx = ieee80211_addr1(frame);
+    out->ap = (msg == 1 || msg == 3) ? tx : rx;
+    out->sta = (msg == 1 || msg == 3) ? rx : tx;
+    out->msg = msg;
+    out->key_info = key_info;
+    out->replay = 0;
+    for (int i = 0; i < 8; i++) {
+        out->replay = (out->replay << 8) | e[EAPOL_OFF_REPLAY + i];
+    }
+    out->nonce = e + EAPOL_OFF_NONCE;
+    out->mic = e + EAPOL_OFF_MIC;
+    out->key_data = e + EAPOL_OFF_KEY_DATA;
+    out->key_data_len = kd_len;
+    out->eapol = e;
+    out->eapol_len = (uint16_t)eapol_len;
+    return true;
+}
+
+void eapol_tracker_reset(eapol_tracker_t* tracker)
+{
+    memset(tracker, 0, sizeof(*tracker));
+}
+
+static eapol_session_t* find(eapol_tracker_t* t, const eapol_key_t* key, uint64_t replay)
+{
+    for (uint32_t i = 0; i < t->count; i++) {
+        eapol_session_t* s = &t->sessions[i];
+        if (s->replay == replay && memcmp(s->ap, key->ap, 6) == 0 && memcmp(s->sta, key->sta, 6) == 0) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+const eapol_session_t* eapol_tracker_add(eapol_tracker_t* t, const eapol_key_t* key)
+{
+    t->msg_count[key->msg - 1]++;
+
+    // M3/M4 normally carry M1's replay counter + 1; some APs reuse it
+    bool late = (key->msg >= 3 && key->replay > 0);
+    eapol_session_t* s = late ? find(t, key, key->replay - 1) : NULL;
+    if (!s) {
+        s = find(t, key, key->replay);
+    }
+
+    if (!s) {
+        if (t->count < EAPOL_TRACKER_MAX_SESSIONS) {
+            s = &t->sessions[t->count++];
+        } else {
+            // Evict the least recently updated exchange
+            s = &t->sessions[0];
+            for (uint32_t i = 1; i < t->count; i++) {
+                if (t->sessions[i].last_used < s->last_used) {
+                    s = &t->sessions[i];
+                }
+            }
+        }
+        memcpy(s->ap, key->ap, 6);
+        memcpy(s->sta, key->sta, 6);
+        s->replay = late ? key->replay - 1 : key->replay;
+        s->msgs = 0;
+    }
+
+    s->msgs |= EAPOL_MSG_BIT(key->msg);
+    s->last_used = ++t->clock;
+    return s;
+}
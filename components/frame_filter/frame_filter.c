@@ -0,0 +1,182 @@
+/**
+ * frame_filter.c
+ *
+ * EAPOL / one-beacon-per-BSSID classifier. The BSSID set is a small
+ * open-addressed table so the per-beacon lookup stays O(1) in the RX callback.
+ * The MGMT and FULL profiles keep more on top of that, never less.
+ */
+
+#include "frame_filter.h"
+#include "ieee80211.h"
+#include <string.h>
+
+#define FRAME_BSS_USED        0x01
+#define FRAME_BSS_BEACON      0x02   // beacon already recorded
+#define FRAME_BSS_HIDDEN      0x04   // that beacon had an empty/zeroed SSID
+#define FRAME_BSS_PROBE_RESP  0x08   // probe response already recorded
+
+#define IEEE80211_CTRL_MIN_LEN  10   // ACK / CTS: frame control, duration, addr1
+#define IEEE80211_RTS_LEN       16   // ... plus addr2
+
+void frame_filter_reset(frame_filter_t* filter)
+{
+    frame_profile_t profile = filter->profile;
+    frame_targets_t targets = filter->targets;
+    memset(filter, 0, sizeof(*filter));
+    filter->profile = profile;
+    filter->targets = targets;
+}
+
+void frame_filter_set_profile(frame_filter_t* filter, frame_profile_t profile)
+{
+    filter->profile = profile;
+}
+
+void frame_filter_set_targets(frame_filter_t* filter, const uint8_t (*addrs)[6], uint32_t count)
+{
+    frame_targets_t* t = &filter->targets;
+    t->count = 0;
+    for (uint32_t i = 0; i < count && i < FRAME_FILTER_MAX_TARGETS; i++) {
+        memcpy(&t->hi[i], addrs[i], 4);
+        memcpy(&t->lo[i], addrs[i] + 4, 2);
+        t->count++;
+    }
+}
+
+// Two loads and two compares per address instead of a 6-byte memcmp
+static inline bool addr_is_target(const frame_targets_t* t, const uint8_t* addr)
+{
+    uint32_t hi;
+    uint16_t lo;
+    memcpy(&hi, addr, 4);
+    memcpy(&lo, addr + 4, 2);
+    for (uint32_t i = 0; i < t->count; i++) {
+        if (hi == t->hi[i] && lo == t->lo[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Control frames stop after addr1 (ACK, CTS) or addr2 (RTS, BlockAck)
+static bool frame_has_target(const frame_targets_t* t, const uint8_t* frame, uint32_t len)
+{
+    return (len >= IEEE80211_CTRL_MIN_LEN && addr_is_target(t, ieee80211_addr1(frame))) ||
+           (len >= IEEE80211_RTS_LEN && addr_is_target(t, ieee80211_addr2(frame))) ||
+           (len >= IEEE80211_HDR_LEN && addr_is_target(t, ieee80211_addr3(frame)));
+}
+
+static frame_bss_slot_t* bss_lookup(frame_filter_t* filter, const uint8_t* addr)
+{
+    // The NIC-specific half of the MAC is the well-distributed part
+    uint32_t i = (addr[3] * 31u + addr[4] * 7u + addr[5]) & (FRAME_FILTER_MAX_BSS - 1);
+    for (uint32_t probe = 0; probe < FRAME_FILTER_MAX_BSS; probe++) {
+        frame_bss_slot_t* slot = &filter->bss[i];
+        if (slot->flags == 0) {
+            if (filter->bss_count >= FRAME_FILTER_MAX_BSS * 3 / 4) {
+                return NULL;   // keep probe chains short
+            }
+            memcpy(slot->addr, addr, 6);
+            slot->flags = FRAME_BSS_USED;
+            filter->bss_count++;
+            return slot;
+        }
+        if (memcmp(slot->addr, addr, 6) == 0) {
+            return slot;
+        }
+        i = (i + 1) & (FRAME_FILTER_MAX_BSS - 1);
+    }
+    return NULL;
+}
+
+static bool ssid_hidden(const uint8_t* frame, uint32_t len)
+{
+    uint8_t ssid_len = 0;
+    const uint8_t* ssid = ieee80211_beacon_ssid(frame, len, &ssid_len);
+    return !ssid || ssid_len == 0 || ssid[0] == 0;
+}
+
+static frame_verdict_t classify_beacon(frame_filter_t* filter, const uint8_t* frame, uint32_t len,
+                                       uint8_t subtype)
+{
+    frame_bss_slot_t* bss = bss_lookup(filter, ieee80211_addr3(frame));
+    if (!bss) {
+        filter->stats.bss_full++;
+        return FRAME_DROP;
+    }
+
+    if (subtype == IEEE80211_SUBTYPE_BEACON) {
+        if (bss->flags & FRAME_BSS_BEACON) {
+            return FRAME_DROP;
+        }
+        bss->flags |= FRAME_BSS_BEACON;
+        if (ssid_hidden(frame, len)) {
+            bss->flags |= FRAME_BSS_HIDDEN;
+        }
+        return FRAME_KEEP_BEACON;
+    }
+
+    // Probe responses are only worth a record when the beacon hid the ESSID
+    if ((bss->flags & FRAME_BSS_PROBE_RESP) ||
+        ((bss->flags & FRAME_BSS_BEACON) && !(bss->flags & FRAME_BSS_HIDDEN)) ||
+        ssid_hidden(frame, len)) {
+        return FRAME_DROP;
+    }
+    bss->flags |= FRAME_BSS_PROBE_RESP;
+    return FRAME_KEEP_BEACON;
+}
+
+static frame_verdict_t classify_mgmt(frame_filter_t* filter, const uint8_t* frame, uint32_t len)
+{
+    uint8_t subtype = IEEE80211_FC0_SUBTYPE(frame[0]);
+    bool beacon = subtype == IEEE80211_SUBTYPE_BEACON;
+    frame_verdict_t verdict = FRAME_DROP;
+    if (beacon || subtype == IEEE80211_SUBTYPE_PROBE_RESP) {
+        verdict = classify_beacon(filter, frame, len, subtype);
+    }
+    // Wider profiles keep the rest too; MGMT still skips repeated beacons
+    if (verdict == FRAME_DROP && filter->profile != FRAME_PROFILE_HANDSHAKE &&
+        (!beacon || filter->profile == FRAME_PROFILE_FULL)) {
+        verdict = FRAME_KEEP_OTHER;
+    }
+    return verdict;
+}
+
+frame_verdict_t frame_filter_classify(frame_filter_t* filter, const uint8_t* frame, uint32_t len)
+{
+    frame_verdict_t verdict = FRAME_DROP;
+
+    if (filter->targets.count && !frame_has_target(&filter->targets, frame, len)) {
+        filter->stats.foreign++;
+        return FRAME_DROP;
+    }
+    if (filter->profile == FRAME_PROFILE_FULL && len >= IEEE80211_CTRL_MIN_LEN &&
+        IEEE80211_FC0_TYPE(frame[0]) != IEEE80211_TYPE_MGMT) {
+        // Data and control frames go through as-is; EAPOL still counts as EAPOL
+        uint32_t eapol_len;
+        verdict = ieee80211_eapol_key(frame, len, &eapol_len) ? FRAME_KEEP_EAPOL : FRAME_KEEP_OTHER;
+    } else if (len >= IEEE80211_HDR_LEN) {
+        switch (IEEE80211_FC0_TYPE(frame[0])) {
+        case IEEE80211_TYPE_MGMT:
+            verdict = classify_mgmt(filter, frame, len);
+            break;
+        case IEEE80211_TYPE_DATA: {
+            uint32_t eapol_len;
+            if (ieee80211_eapol_key(frame, len, &eapol_len)) {
+                verdict = FRAME_KEEP_EAPOL;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    switch (verdict) {
+    case FRAME_KEEP_EAPOL:  filter->stats.eapol++;   break;
+    case FRAME_KEEP_BEACON: filter->stats.beacons++; break;
+    case FRAME_KEEP_OTHER:  filter->stats.other++;   break;
+    default:                filter->stats.dropped++; break;
+    }
+    return verdict;
+}
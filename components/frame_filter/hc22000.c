@@ -0,0 +1,294 @@
+/**
+ * hc22000.c
+ *
+ * Builds hashcat 22000 lines from parsed EAPOL-Key messages and beacon SSIDs.
+ */
+
+#include "hc22000.h"
+#include "ieee80211.h"
+#include <string.h>
+
+// hc22000_pair_t::have
+#define HAVE_M1      0x01
+#define HAVE_M2      0x02
+#define HAVE_M3      0x04
+#define HAVE_PMKID   0x08
+
+// hc22000_pair_t::emitted
+#define EMIT_PMKID   0x01
+#define EMIT_M1M2    0x02
+#define EMIT_M2M3    0x04
+
+// Message pair field: ANonce from M1 / from M3, EAPOL always from M2, replay counters checked
+#define MP_M1M2      0x00
+#define MP_M2M3      0x02
+
+#define KDE_TYPE     0xdd
+#define KDE_PMKID    4
+
+static const uint8_t rsn_oui[3] = { 0x00, 0x0f, 0xac };
+
+static const hc22000_essid_t* find_essid(const hc22000_t* hc, const uint8_t* bssid)
+{
+    for (uint32_t i = 0; i < hc->essid_count; i++) {
+        if (memcmp(hc->essids[i].bssid, bssid, 6) == 0) {
+            return &hc->essids[i];
+        }
+    }
+    return NULL;
+}
+
+static hc22000_pair_t* find_pair(hc22000_t* hc, const uint8_t* ap, const uint8_t* sta)
+{
+    for (uint32_t i = 0; i < hc->pair_count; i++) {
+        hc22000_pair_t* p = &hc->pairs[i];
+        if (memcmp(p->ap, ap, 6) == 0 && memcmp(p->sta, sta, 6) == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static hc22000_pair_t* get_pair(hc22000_t* hc, const uint8_t* ap, const uint8_t* sta)
+{
+    hc22000_pair_t* p = find_pair(hc, ap, sta);
+    if (!p) {
+        if (hc->pair_count < HC22000_MAX_PAIRS) {
+            p = &hc->pairs[hc->pair_count++];
+        } else {
+            p = &hc->pairs[0];
+            for (uint32_t i = 1; i < hc->pair_count; i++) {
+                if (hc->pairs[i].last_used < p->last_used) {
+                    p = &hc->pairs[i];
+                }
+            }
+        }
+        memset(p, 0, sizeof(*p));
+        memcpy(p->ap, ap, 6);
+        memcpy(p->sta, sta, 6);
+    }
+    p->last_used = ++hc->clock;
+    return p;
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Line assembly
+
+static char* put_hex(char* out, const uint8_t* data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        *out++ = digits[data[i] >> 4];
+        *out++ = digits[data[i] & 0xf];
+    }
+    return out;
+}
+
+static char* put_str(char* out, const char* s)
+{
+    size_t n = strlen(s);
+    memcpy(out, s, n);
+    return out + n;
+}
+
+// "WPA*0t*<hash>*<ap>*<sta>*<essid>*" common to both line types
+static char* put_prefix(char* out, const char* type, const uint8_t* hash, size_t hash_len,
+                        const hc22000_pair_t* p, const hc22000_essid_t* essid)
+{
+    out = put_str(out, type);
+    out = put_hex(out, hash, hash_len);
+    *out++ = '*';
+    out = put_hex(out, p->ap, 6);
+    *out++ = '*';
+    out = put_hex(out, p->sta, 6);
+    *out++ = '*';
+    out = put_hex(out, essid->ssid, essid->len);
+    *out++ = '*';
+    return out;
+}
+
+static void emit_line(hc22000_t* hc, char* end)
+{
+    *end++ = '\n';
+    *end = 0;
+    hc->lines++;
+    if (hc->emit) {
+        hc->emit(hc->ctx, hc->line, end - hc->line);
+    }
+}
+
+static void emit_pmkid(hc22000_t* hc, const hc22000_pair_t* p, const hc22000_essid_t* essid)
+{
+    char* out = put_prefix(hc->line, "WPA*01*", p->pmkid, HC22000_PMKID_LEN, p, essid);
+    out = put_str(out, "**");
+    emit_line(hc, out);
+}
+
+static void emit_eapol(hc22000_t* hc, const hc22000_pair_t* p, const hc22000_essid_t* essid,
+                       const uint8_t* anonce, uint8_t mp)
+{
+    char* out = put_prefix(hc->line, "WPA*02*", p->mic, EAPOL_MIC_LEN, p, essid);
+    out = put_hex(out, anonce, EAPOL_NONCE_LEN);
+    *out++ = '*';
+    out = put_hex(out, p->eapol, p->eapol_len);
+    *out++ = '*';
+    out = put_hex(out, &mp, 1);
+    emit_line(hc, out);
+}
+
+// Emit every line the pair can produce that has not been written yet
+static void try_emit(hc22000_t* hc, hc22000_pair_t* p)
+{
+    const hc22000_essid_t* essid = find_essid(hc, p->ap);
+    if (!essid) {
+        return;   // retried when the beacon shows up
+    }
+
+    if ((p->have & HAVE_PMKID) && !(p->emitted & EMIT_PMKID)) {
+        emit_pmkid(hc, p, essid);
+        p->emitted |= EMIT_PMKID;
+    }
+    if (!(p->have & HAVE_M2)) {
+        return;
+    }
+    // Prefer M1+M2; fall back to M2+M3 when M1 was missed
+    if ((p->have & HAVE_M1) && p->m1_replay == p->m2_replay) {
+        if (!(p->emitted & EMIT_M1M2)) {
+            emit_eapol(hc, p, essid, p->m1_anonce, MP_M1M2);
+            p->emitted |= EMIT_M1M2;
+        }
+    } else if ((p->have & HAVE_M3) && !(p->emitted & EMIT_M2M3) &&
+               (p->m3_replay == p->m2_replay + 1 || p->m3_replay == p->m2_replay)) {
+        emit_eapol(hc, p, essid, p->m3_anonce, MP_M2M3);
+        p->emitted |= EMIT_M2M3;
+    }
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Message intake
+
+// PMKID KDE (00:0f:ac type 4) in M1 key data, NULL if absent or all zero
+static const uint8_t* find_pmkid(const uint8_t* kd, uint32_t len)
+{
+    static const uint8_t zero[HC22000_PMKID_LEN] = {0};
+    uint32_t off = 0;
+    while (off + 2 <= len) {
+        uint8_t type = kd[off], kde_len = kd[off + 1];
+        if (off + 2 + kde_len > len) {
+            break;
+        }
+        const uint8_t* body = kd + off + 2;
+        if (type == KDE_TYPE && kde_len >= 4 + HC22000_PMKID_LEN &&
+            memcmp(body, rsn_oui, 3) == 0 && body[3] == KDE_PMKID &&
+            memcmp(body + 4, zero, HC22000_PMKID_LEN) != 0) {
+            return body + 4;
+        }
+        off += 2 + kde_len;
+    }
+    return NULL;
+}
+
+static void add_m1(hc22000_pair_t* p, const eapol_key_t* key)
+{
+    if (!(p->have & HAVE_M1) || p->m1_replay != key->replay ||
+        memcmp(p->m1_anonce, key->nonce, EAPOL_NONCE_LEN) != 0) {
+        memcpy(p->m1_anonce, key->nonce, EAPOL_NONCE_LEN);
+        p->m1_replay = key->replay;
+        p->have |= HAVE_M1;
+        p->emitted &= ~EMIT_M1M2;
+    }
+    const uint8_t* pmkid = find_pmkid(key->key_data, key->key_data_len);
+    if (pmkid && memcmp(p->pmkid, pmkid, HC22000_PMKID_LEN) != 0) {
+        memcpy(p->pmkid, pmkid, HC22000_PMKID_LEN);
+        p->have |= HAVE_PMKID;
+        p->emitted &= ~EMIT_PMKID;
+    }
+}
+
+static void add_m2(hc22000_pair_t* p, const eapol_key_t* key)
+{
+    if (key->eapol_len > HC22000_MAX_EAPOL) {
+        return;   // hashcat cannot take it
+    }
+    if ((p->have & HAVE_M2) && p->m2_replay == key->replay &&
+        memcmp(p->mic, key->mic, EAPOL_MIC_LEN) == 0) {
+        return;   // retransmission
+    }
+    memcpy(p->mic, key->mic, EAPOL_MIC_LEN);
+    memcpy(p->eapol, key->eapol, key->eapol_len);
+    memset(p->eapol + (key->mic - key->eapol), 0, EAPOL_MIC_LEN);
+    p->eapol_len = key->eapol_len;
+    p->m2_replay = key->replay;
+    p->have |= HAVE_M2;
+    p->emitted &= ~(EMIT_M1M2 | EMIT_M2M3);
+}
+
+static void add_m3(hc22000_pair_t* p, const eapol_key_t* key)
+{
+    if (!(p->have & HAVE_M3) || p->m3_replay != key->replay ||
+        memcmp(p->m3_anonce, key->nonce, EAPOL_NONCE_LEN) != 0) {
+        memcpy(p->m3_anonce, key->nonce, EAPOL_NONCE_LEN);
+        p->m3_replay = key->replay;
+        p->have |= HAVE_M3;
+        p->emitted &= ~EMIT_M2M3;
+    }
+}
+
+void hc22000_init(hc22000_t* hc, hc22000_emit_fn emit, void* ctx)
+{
+    memset(hc, 0, sizeof(*hc));
+    hc->emit = emit;
+    hc->ctx = ctx;
+}
+
+void hc22000_add_beacon(hc22000_t* hc, const uint8_t* frame, uint32_t len)
+{
+    if (len < IEEE80211_HDR_LEN || IEEE80211_FC0_TYPE(frame[0]) != IEEE80211_TYPE_MGMT) {
+        return;
+    }
+    uint8_t subtype = IEEE80211_FC0_SUBTYPE(frame[0]);
+    if (subtype != IEEE80211_SUBTYPE_BEACON && subtype != IEEE80211_SUBTYPE_PROBE_RESP) {
+        return;
+    }
+    uint8_t ssid_len;
+    const uint8_t* ssid = ieee80211_beacon_ssid(frame, len, &ssid_len);
+    if (!ssid || ssid_len == 0 || ssid_len > 32 || ssid[0] == 0) {
+        return;   // hidden: wait for a probe response
+    }
+
+    const uint8_t* bssid = ieee80211_bssid(frame);
+    if (find_essid(hc, bssid)) {
+        return;
+    }
+    hc22000_essid_t* e;
+    if (hc->essid_count < HC22000_MAX_ESSIDS) {
+        e = &hc->essids[hc->essid_count++];
+    } else {
+        e = &hc->essids[hc->essid_next];
+        hc->essid_next = (hc->essid_next + 1) % HC22000_MAX_ESSIDS;
+    }
+    memcpy(e->bssid, bssid, 6);
+    memcpy(e->ssid, ssid, ssid_len);
+    e->len = ssid_len;
+
+    // Handshakes seen before the beacon can be written now
+    for (uint32_t i = 0; i < hc->pair_count; i++) {
+        if (memcmp(hc->pairs[i].ap, bssid, 6) == 0) {
+            try_emit(hc, &hc->pairs[i]);
+        }
+    }
+}
+
+void hc22000_add_key(hc22000_t* hc, const eapol_key_t* key)
+{
+    if (key->msg == 4) {
+        return;   // M4 adds nothing M2 does not already have
+    }
+    hc22000_pair_t* p = get_pair(hc, key->ap, key->sta);
+    switch (key->msg) {
+    case 1: add_m1(p, key); break;
+    case 2: add_m2(p, key); break;
+    case 3: add_m3(p, key); break;
+    }
+    try_emit(hc, p);
+}
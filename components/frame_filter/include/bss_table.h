@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Passive table of BSSes and their associated stations, fed from raw frames.
+ *
+ * Beacons and probe responses create or refresh a BSS (ESSID, channel,
+ * security); data frames refresh the BSS and the station on the other end.
+ * Both sets are open-addressed, linear-probing hash tables over caller-owned
+ * slot arrays, so memory is fixed at init and a lookup is a couple of compares
+ * in the RX callback. When a set is at its entry limit the stalest of a few
+ * entries under a clock hand is evicted, so the cost does not grow with the
+ * table; expired entries are removed with backward-shift deletion so
+ * probe chains never carry tombstones.
+ *
+ * Not thread-safe: the caller serialises observe/expire/copy.
+ */
+
+typedef enum {
+    BSS_AUTH_UNKNOWN = 0,   // only seen in data frames so far
+    BSS_AUTH_OPEN,
+    BSS_AUTH_WEP,
+    BSS_AUTH_WPA,
+    BSS_AUTH_WPA2,
+    BSS_AUTH_WPA_WPA2,
+    BSS_AUTH_WPA2_ENTERPRISE,
+    BSS_AUTH_WPA3,
+    BSS_AUTH_WPA2_WPA3,
+} bss_auth_t;
+
+typedef struct {
+    uint8_t  bssid[6];
+    uint8_t  used;           // non-zero = slot holds an entry
+    uint8_t  channel;        // DS parameter set, else the RX channel
+    uint8_t  auth;           // bss_auth_t
+    uint8_t  ssid_len;       // 0 = hidden or not seen yet
+    int16_t  rssi_x16;       // EWMA of the AP's own frames, 1/16 dBm
+    uint8_t  ssid[32];
+    uint32_t beacons;        // beacons and probe responses
+    uint32_t frames;         // every frame to or from the BSS
+    int64_t  last_seen_us;
+} bss_entry_t;
+
+typedef struct {
+    uint8_t  mac[6];
+    uint8_t  used;
+    uint8_t  bssid[6];       // BSS the station last exchanged data with
+    int16_t  rssi_x16;       // EWMA of frames the station sent, 1/16 dBm (0 = none yet)
+    uint32_t frames;
+    int64_t  last_seen_us;
+} bss_station_t;
+
+typedef struct {
+    bss_entry_t*   bss;
+    uint32_t       bss_mask;     // slot count - 1
+    uint32_t       bss_max;      // live entries allowed
+    uint32_t       bss_count;
+    bss_station_t* sta;
+    uint32_t       sta_mask;
+    uint32_t       sta_max;
+    uint32_t       sta_count;
+    uint32_t       bss_hand;     // eviction clock hands, slot indices
+    uint32_t       sta_hand;
+    uint32_t       evictions;    // entries pushed out by a full set
+} bss_table_t;
+
+/**
+ * @brief Slot count for `max` entries: the next power of two at or above 2 * max,
+ *        which keeps the load factor at or below one half.
+ */
+uint32_t bss_table_slots(uint32_t max);
+
+/**
+ * @brief Attach zeroed slot arrays sized with bss_table_slots() and clear the table.
+ */
+void bss_table_init(bss_table_t* t, bss_entry_t* bss, uint32_t bss_max,
+                    bss_station_t* sta, uint32_t sta_max);
+
+/**
+ * @brief Update the table from one frame (raw MPDU, no FCS).
+ * @param rssi    Signal of this frame.
+ * @param channel Channel it was received on.
+ */
+void bss_table_observe(bss_table_t* t, const uint8_t* frame, uint32_t len,
+                       int8_t rssi, uint8_t channel, int64_t now_us);
+
+/**
+ * @brief Insert or refresh a BSS from a result obtained elsewhere (e.g. an active scan).
+ */
+void bss_table_add(bss_table_t* t, const uint8_t bssid[6], const uint8_t* ssid, uint8_t ssid_len,
+                   uint8_t channel, int8_t rssi, bss_auth_t auth, int64_t now_us);
+
+/**
+ * @brief Remove every BSS and station last seen before `cutoff_us`.
+ */
+void bss_table_expire(bss_table_t* t, int64_t cutoff_us);
+
+/**
+ * @brief Number of stations currently attributed to `bssid`.
+ */
+uint32_t bss_table_station_count(const bss_table_t* t, const uint8_t bssid[6]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Incremental 4-way handshake tracker.
+ *
+ * EAPOL-Key frames are parsed into eapol_key_t and grouped by (AP, STA,
+ * replay counter) so that messages of the same exchange are recognised even
+ * when several clients or retries are interleaved. Pure logic, no locking:
+ * feed it from a single task.
+ */
+
+#define EAPOL_TRACKER_MAX_SESSIONS  8
+
+// Bits of eapol_session_t::msgs
+#define EAPOL_MSG_BIT(n)   (1u << ((n) - 1))
+#define EAPOL_MSGS_M1M2    (EAPOL_MSG_BIT(1) | EAPOL_MSG_BIT(2))
+#define EAPOL_MSGS_M2M3    (EAPOL_MSG_BIT(2) | EAPOL_MSG_BIT(3))
+#define EAPOL_MSGS_ALL     (EAPOL_MSG_BIT(1) | EAPOL_MSG_BIT(2) | EAPOL_MSG_BIT(3) | EAPOL_MSG_BIT(4))
+
+#define EAPOL_NONCE_LEN    32
+#define EAPOL_MIC_LEN      16
+
+typedef struct {
+    const uint8_t* ap;          // authenticator MAC
+    const uint8_t* sta;         // supplicant MAC
+    uint8_t        msg;         // 1..4
+    uint16_t       key_info;
+    uint64_t       replay;
+    const uint8_t* nonce;       // EAPOL_NONCE_LEN bytes
+    const uint8_t* mic;         // EAPOL_MIC_LEN bytes
+    const uint8_t* key_data;
+    uint16_t       key_data_len;
+    const uint8_t* eapol;       // 802.1X header onwards
+    uint16_t       eapol_len;   // 802.1X header + body, as declared in the header
+} eapol_key_t;
+
+typedef struct {
+    uint8_t  ap[6];
+    uint8_t  sta[6];
+    uint64_t replay;            // replay counter of M1/M2 (M3/M4 carry replay + 1)
+    uint8_t  msgs;              // EAPOL_MSG_BIT() of every message seen
+    uint32_t last_used;
+} eapol_session_t;
+
+typedef struct {
+    eapol_session_t sessions[EAPOL_TRACKER_MAX_SESSIONS];
+    uint32_t        count;
+    uint32_t        clock;
+    uint32_t        msg_count[4];  // M1..M4 frames seen
+} eapol_tracker_t;
+
+/**
+ * @brief Parse a pairwise EAPOL-Key frame (raw MPDU, no FCS).
+ * @return false if the frame is not a pairwise EAPOL-Key message.
+ */
+bool eapol_parse(const uint8_t* frame, uint32_t len, eapol_key_t* out);
+
+/**
+ * @brief Forget every session.
+ */
+void eapol_tracker_reset(eapol_tracker_t* tracker);
+
+/**
+ * @brief Record a parsed message.
+ * @return The session it belongs to (its msgs field includes this message).
+ */
+const eapol_session_t* eapol_tracker_add(eapol_tracker_t* tracker, const eapol_key_t* key);
+
+/**
+ * @brief True if the session holds a crackable message pair (M1+M2 or M2+M3).
+ */
+static inline bool eapol_session_has_pair(const eapol_session_t* s)
+{
+    return (s->msgs & EAPOL_MSGS_M1M2) == EAPOL_MSGS_M1M2 ||
+           (s->msgs & EAPOL_MSGS_M2M3) == EAPOL_MSGS_M2M3;
+}
+
+#ifdef __cplusplus
+}
+#endif
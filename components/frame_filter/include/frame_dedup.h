@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Duplicate suppression for the capture writer.
+ *
+ * A monitor radio hears every retransmission of a frame the receiver failed
+ * to ACK, and the driver may hand the same MPDU up twice. Each management
+ * and data frame is hashed over everything except the duration field and the
+ * retry bit (so addresses, sequence control and payload all count), and the
+ * hash is kept in a small direct-mapped table for a short window; a frame
+ * whose hash and length are in the table and younger than the window is a
+ * duplicate. Control frames carry no sequence number and are never dropped.
+ *
+ * A direct-mapped table can only forget: a colliding frame evicts the older
+ * entry and a later copy of that one is then kept, never the other way round.
+ *
+ * Not thread-safe: one instance per consumer.
+ */
+
+typedef struct {
+    uint32_t hash;
+    uint32_t len;            // stored length and on-air length, 16 bits each
+    uint32_t seen_ms;
+} frame_dedup_entry_t;
+
+typedef struct {
+    uint32_t checked;        // frames looked up
+    uint32_t duplicates;     // ... of which were seen within the window
+} frame_dedup_stats_t;
+
+typedef struct {
+    frame_dedup_entry_t* entries;
+    uint32_t             mask;       // entry count - 1
+    uint32_t             window_ms;
+    frame_dedup_stats_t  stats;
+} frame_dedup_t;
+
+/**
+ * @brief Attach a caller-owned entry array and clear the set.
+ * @param count     Entries in the array; only the largest power of two at or below it is used.
+ * @param window_ms Age after which a remembered frame no longer matches.
+ */
+void frame_dedup_init(frame_dedup_t* d, frame_dedup_entry_t* entries, uint32_t count, uint32_t window_ms);
+
+/**
+ * @brief Forget every frame and zero the stats.
+ */
+void frame_dedup_reset(frame_dedup_t* d);
+
+/**
+ * @brief Look a frame up and remember it.
+ * @param len      Bytes present (raw MPDU, no FCS, possibly truncated).
+ * @param orig_len On-air length.
+ * @param now_ms   Receive time of the frame; may wrap.
+ * @return true if the same frame was seen within the window.
+ */
+bool frame_dedup_seen(frame_dedup_t* d, const uint8_t* frame, uint32_t len, uint32_t orig_len,
+                      uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Cheap first-stage classifier for the promiscuous RX path.
+ *
+ * Keeps EAPOL-Key frames and the first beacon seen from each BSSID (plus one
+ * probe response when that beacon hides its SSID), so the capture holds the
+ * handshake and the ESSID needed to crack it and nothing else. It runs in the
+ * Wi-Fi RX callback before any copy, so it only looks at a few header bytes.
+ *
+ * The profile widens what is kept for other kinds of capture; the driver's
+ * promiscuous filter should be set to match so dropped classes never reach
+ * the callback at all. An optional target set restricts everything to frames
+ * that carry one of a few addresses in addr1/addr2/addr3; it is checked first.
+ *
+ * Not thread-safe: one filter instance per producer.
+ */
+
+#define FRAME_FILTER_MAX_BSS      64   // BSSIDs remembered per run (power of two)
+#define FRAME_FILTER_MAX_TARGETS  4    // addresses in the target set
+
+typedef enum {
+    FRAME_PROFILE_HANDSHAKE = 0,   // EAPOL-Key + first beacon per BSSID (the default)
+    FRAME_PROFILE_MGMT,            // every management frame, beacons still once per BSSID
+    FRAME_PROFILE_FULL,            // everything, control frames included
+} frame_profile_t;
+
+typedef enum {
+    FRAME_DROP = 0,
+    FRAME_KEEP_EAPOL,
+    FRAME_KEEP_BEACON,
+    FRAME_KEEP_OTHER,     // kept only because the profile asks for it
+} frame_verdict_t;
+
+typedef struct {
+    uint32_t eapol;       // EAPOL-Key frames kept
+    uint32_t beacons;     // beacons / probe responses kept
+    uint32_t other;       // other frames kept by the MGMT / FULL profiles
+    uint32_t foreign;     // frames rejected because no address is in the target set
+    uint32_t dropped;     // frames rejected
+    uint32_t bss_full;    // beacons dropped because the BSSID table was full
+} frame_filter_stats_t;
+
+typedef struct {
+    uint8_t addr[6];
+    uint8_t flags;        // FRAME_BSS_* bits, 0 = empty slot
+} frame_bss_slot_t;
+
+// Target addresses split into the two words compared per address field
+typedef struct {
+    uint32_t hi[FRAME_FILTER_MAX_TARGETS];   // bytes 0..3
+    uint16_t lo[FRAME_FILTER_MAX_TARGETS];   // bytes 4..5
+    uint8_t  count;                          // 0 = no address filtering
+} frame_targets_t;
+
+typedef struct {
+    frame_bss_slot_t     bss[FRAME_FILTER_MAX_BSS];
+    uint32_t             bss_count;
+    frame_profile_t      profile;
+    frame_targets_t      targets;
+    frame_filter_stats_t stats;
+} frame_filter_t;
+
+/**
+ * @brief Forget all BSSIDs and counters; the profile and target set are kept.
+ */
+void frame_filter_reset(frame_filter_t* filter);
+
+/**
+ * @brief Select what the filter keeps from the next frame on.
+ */
+void frame_filter_set_profile(frame_filter_t* filter, frame_profile_t profile);
+
+/**
+ * @brief Keep only frames with one of `count` addresses (6 bytes each, at most
+ *        FRAME_FILTER_MAX_TARGETS) in addr1, addr2 or addr3. count 0 keeps all.
+ */
+void frame_filter_set_targets(frame_filter_t* filter, const uint8_t (*addrs)[6], uint32_t count);
+
+/**
+ * @brief Decide whether a frame (raw MPDU, no FCS) is worth recording.
+ */
+frame_verdict_t frame_filter_classify(frame_filter_t* filter, const uint8_t* frame, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "eapol_tracker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Incremental hashcat 22000 converter.
+ *
+ * Fed the same parsed EAPOL-Key messages as the tracker plus the beacons /
+ * probe responses kept by the classifier, it emits one text line per
+ * crackable item as soon as all of its parts have been seen:
+ *
+ *   WPA*01*PMKID*MAC_AP*MAC_STA*ESSID***            (PMKID from M1)
+ *   WPA*02*MIC*MAC_AP*MAC_STA*ESSID*ANONCE*EAPOL*MP (M1+M2 → MP 00, M2+M3 → MP 02)
+ *
+ * Each item is emitted once; a retransmitted frame with the same contents
+ * does not produce a duplicate line. Pure logic, no locking: feed it from a
+ * single task.
+ */
+
+#define HC22000_MAX_PAIRS    8     // (AP, STA) pairs followed at once
+#define HC22000_MAX_ESSIDS   8
+#define HC22000_MAX_EAPOL    256   // hashcat's limit for the EAPOL field
+#define HC22000_PMKID_LEN    16
+
+// Longest line: WPA*02 with a full EAPOL field and a 32-byte ESSID
+#define HC22000_LINE_MAX     (7 + 2 * EAPOL_MIC_LEN + 1 + 12 + 1 + 12 + 1 + 64 + 1 + \
+                              2 * EAPOL_NONCE_LEN + 1 + 2 * HC22000_MAX_EAPOL + 1 + 2 + 2)
+
+typedef void (*hc22000_emit_fn)(void* ctx, const char* line, size_t len);
+
+typedef struct {
+    uint8_t  ap[6];
+    uint8_t  sta[6];
+    uint8_t  have;                         // parts present, see hc22000.c
+    uint8_t  emitted;                      // lines already written for the current parts
+    uint64_t m1_replay;
+    uint64_t m2_replay;
+    uint64_t m3_replay;
+    uint8_t  m1_anonce[EAPOL_NONCE_LEN];
+    uint8_t  m3_anonce[EAPOL_NONCE_LEN];
+    uint8_t  pmkid[HC22000_PMKID_LEN];
+    uint8_t  mic[EAPOL_MIC_LEN];           // M2 MIC
+    uint16_t eapol_len;
+    uint8_t  eapol[HC22000_MAX_EAPOL];     // M2 802.1X frame with the MIC zeroed
+    uint32_t last_used;
+} hc22000_pair_t;
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t len;
+    uint8_t ssid[32];
+} hc22000_essid_t;
+
+typedef struct {
+    hc22000_pair_t  pairs[HC22000_MAX_PAIRS];
+    uint32_t        pair_count;
+    uint32_t        clock;
+    hc22000_essid_t essids[HC22000_MAX_ESSIDS];
+    uint32_t        essid_count;
+    uint32_t        essid_next;            // round-robin victim once the table is full
+    uint32_t        lines;                 // lines emitted since init
+    hc22000_emit_fn emit;
+    void*           ctx;
+    char            line[HC22000_LINE_MAX];
+} hc22000_t;
+
+/**
+ * @brief Reset the converter; emit is called with each finished line ('\n' terminated).
+ */
+void hc22000_init(hc22000_t* hc, hc22000_emit_fn emit, void* ctx);
+
+/**
+ * @brief Learn the ESSID of a BSS from a beacon or probe response (raw MPDU, no FCS).
+ *        Other frames and hidden SSIDs are ignored.
+ */
+void hc22000_add_beacon(hc22000_t* hc, const uint8_t* frame, uint32_t len);
+
+/**
+ * @brief Record a parsed EAPOL-Key message and emit whatever it completes.
+ */
+void hc22000_add_key(hc22000_t* hc, const eapol_key_t* key);
+
+#ifdef __cplusplus
+}
+#endif
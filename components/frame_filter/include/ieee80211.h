@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Minimal 802.11 / EAPOL framing helpers shared by the capture filters.
+ * All functions take the raw MPDU as delivered by the promiscuous callback
+ * (no FCS) and never read past len.
+ */
+
+#define IEEE80211_HDR_LEN           24
+#define IEEE80211_FC0_TYPE(fc0)     (((fc0) >> 2) & 0x3)
+#define IEEE80211_FC0_SUBTYPE(fc0)  (((fc0) >> 4) & 0xf)
+
+#define IEEE80211_TYPE_MGMT         0
+#define IEEE80211_TYPE_CTRL         1
+#define IEEE80211_TYPE_DATA         2
+
+#define IEEE80211_SUBTYPE_PROBE_RESP  5
+#define IEEE80211_SUBTYPE_BEACON      8
+#define IEEE80211_SUBTYPE_QOS_BIT     0x8   // data subtypes 8..15 carry QoS control
+
+#define IEEE80211_FC1_TODS          0x01
+#define IEEE80211_FC1_FROMDS        0x02
+#define IEEE80211_FC1_RETRY         0x08
+#define IEEE80211_FC1_PROTECTED     0x40
+#define IEEE80211_FC1_ORDER         0x80
+
+#define IEEE80211_BEACON_FIXED_LEN  12      // timestamp, interval, capabilities
+#define IEEE80211_IE_SSID           0
+
+#define EAPOL_TYPE_KEY              3
+#define EAPOL_HDR_LEN               4       // version, type, body length
+#define EAPOL_KEY_MIN_LEN           (EAPOL_HDR_LEN + 95)
+
+static inline const uint8_t* ieee80211_addr1(const uint8_t* f) { return f + 4; }
+static inline const uint8_t* ieee80211_addr2(const uint8_t* f) { return f + 10; }
+static inline const uint8_t* ieee80211_addr3(const uint8_t* f) { return f + 16; }
+
+/**
+ * @brief MAC header length of a data frame (addr4, QoS and HT control aware).
+ */
+static inline uint32_t ieee80211_data_hdr_len(const uint8_t* f)
+{
+    uint32_t len = IEEE80211_HDR_LEN;
+    if ((f[1] & (IEEE80211_FC1_TODS | IEEE80211_FC1_FROMDS)) ==
+        (IEEE80211_FC1_TODS | IEEE80211_FC1_FROMDS)) {
+        len += 6;
+    }
+    if (IEEE80211_FC0_SUBTYPE(f[0]) & IEEE80211_SUBTYPE_QOS_BIT) {
+        len += 2;
+        if (f[1] & IEEE80211_FC1_ORDER) {
+            len += 4;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief Locate the EAPOL-Key PDU inside an unprotected data frame.
+ * @param[out] eapol_len Bytes from the EAPOL header to the end of the frame.
+ * @return Pointer to the EAPOL header (version byte), or NULL.
+ */
+static inline const uint8_t* ieee80211_eapol_key(const uint8_t* f, uint32_t len, uint32_t* eapol_len)
+{
+    static const uint8_t llc_eapol[8] = { 0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00, 0x88, 0x8e };
+
+    if (len < IEEE80211_HDR_LEN || IEEE80211_FC0_TYPE(f[0]) != IEEE80211_TYPE_DATA ||
+        (f[1] & IEEE80211_FC1_PROTECTED)) {
+        return NULL;
+    }
+    uint32_t off = ieee80211_data_hdr_len(f);
+    if (len < off + sizeof(llc_eapol) + EAPOL_KEY_MIN_LEN ||
+        memcmp(f + off, llc_eapol, sizeof(llc_eapol)) != 0) {
+        return NULL;
+    }
+    off += sizeof(llc_eapol);
+    if (f[off + 1] != EAPOL_TYPE_KEY) {
+        return NULL;
+    }
+    *eapol_len = len - off;
+    return f + off;
+}
+
+/**
+ * @brief BSSID of a management frame or of a non-WDS data frame.
+ */
+static inline const uint8_t* ieee80211_bssid(const uint8_t* f)
+{
+    if (IEEE80211_FC0_TYPE(f[0]) == IEEE80211_TYPE_DATA) {
+        switch (f[1] & (IEEE80211_FC1_TODS | IEEE80211_FC1_FROMDS)) {
+        case IEEE80211_FC1_TODS:   return ieee80211_addr1(f);
+        case IEEE80211_FC1_FROMDS: return ieee80211_addr2(f);
+        default:                   return ieee80211_addr3(f);
+        }
+    }
+    return ieee80211_addr3(f);
+}
+
+/**
+ * @brief Find the SSID element of a beacon / probe response.
+ * @param[out] ssid_len SSID length (0 for a wildcard / hidden SSID).
+ * @return Pointer to the SSID bytes, or NULL if the element is missing.
+ */
+static inline const uint8_t* ieee80211_beacon_ssid(const uint8_t* f, uint32_t len, uint8_t* ssid_len)
+{
+    uint32_t off = IEEE80211_HDR_LEN + IEEE80211_BEACON_FIXED_LEN;
+    while (off + 2 <= len) {
+        uint8_t id = f[off], ie_len = f[off + 1];
+        if (off + 2 + ie_len > len) {
+            break;
+        }
+        if (id == IEEE80211_IE_SSID) {
+            *ssid_len = ie_len;
+            return f + off + 2;
+        }
+        off += 2 + ie_len;
+    }
+    return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
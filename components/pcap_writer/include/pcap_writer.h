@@ -3,31 +3,173 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <sys/time.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define PCAP_WRITER_BLOCK_SIZE    4096  // flash sector; buffer sizes are rounded up to this
+#define PCAP_LINKTYPE_IEEE802_11           105
+#define PCAP_LINKTYPE_IEEE802_11_RADIOTAP  127  // each frame is preceded by a radiotap header
+
+#define PCAP_RADIOTAP_MAX_LEN     20    // longest radiotap header the writer emits
+#define PCAP_RADIO_NO_MCS         0xff
+
+typedef enum {
+    PCAP_WRITER_FORMAT_PCAP,     // classic libpcap file
+    PCAP_WRITER_FORMAT_PCAPNG,   // section + interface description + enhanced packet blocks
+} pcap_writer_format_t;
+
+/**
+ * @brief Opaque PCAP writer handle. Each handle owns its file and write buffer,
+ *        so several captures can be written at the same time.
+ */
+typedef struct pcap_writer pcap_writer_t;
+
+typedef struct {
+    size_t   buffer_size;        // write buffer size; every full flush is one write of this size
+    uint32_t flush_interval_ms;  // max age of buffered data before pcap_writer_poll() flushes it
+    uint32_t snaplen;            // packets longer than this are truncated
+    uint32_t linktype;           // PCAP data link type
+    pcap_writer_format_t format;
+    const char* if_name;         // pcapng interface name option (NULL to omit)
+    const char* if_description;  // pcapng interface description option (NULL to omit)
+    void*    arena;              // caller-owned RAM to record into (NULL: write the file as we go)
+    size_t   arena_size;         // bytes at arena; replaces buffer_size when arena is set
+    // Optional instrumentation: called after each buffer write with its duration in CPU cycles
+    void   (*on_flush)(void* ctx, size_t len, bool ok, uint32_t cycles);
+    void*    on_flush_ctx;
+} pcap_writer_config_t;
+
+#define PCAP_WRITER_DEFAULT_CONFIG() {          \
+    .buffer_size = PCAP_WRITER_BLOCK_SIZE,      \
+    .flush_interval_ms = 1000,                  \
+    .snaplen = 0xffff,                          \
+    .linktype = PCAP_LINKTYPE_IEEE802_11,       \
+    .format = PCAP_WRITER_FORMAT_PCAP,          \
+    .if_name = NULL,                            \
+    .if_description = NULL,                     \
+    .arena = NULL,                              \
+    .arena_size = 0,                            \
+    .on_flush = NULL,                           \
+    .on_flush_ctx = NULL,                       \
+}
+
+/**
+ * @brief Receive conditions of one frame, written as a radiotap header when the
+ *        writer's linktype is PCAP_LINKTYPE_IEEE802_11_RADIOTAP.
+ */
+typedef struct {
+    int8_t   rssi;       // signal, dBm
+    int8_t   noise;      // noise floor, dBm (0 = unknown)
+    uint16_t freq_mhz;   // channel centre frequency (0 = unknown)
+    uint8_t  rate;       // legacy rate in 500 kb/s units (0 = HT or unknown)
+    uint8_t  mcs;        // HT MCS index, PCAP_RADIO_NO_MCS for legacy frames
+    bool     bw40;       // HT 40 MHz
+    bool     sgi;        // HT short guard interval
+} pcap_radio_info_t;
+
+typedef struct {
+    uint32_t packets;   // packets accepted
+    uint32_t bytes;     // bytes handed to the file (headers included)
+    uint32_t flushes;   // write calls issued
+    uint32_t errors;    // failed writes
+    uint32_t pending;   // bytes accepted but not written to the file yet
+} pcap_writer_stats_t;
+
+/**
+ * @brief Destination for the writer's output, for storage that is not a VFS file.
+ *
+ * write() receives whole buffers (buffer_size bytes, or arena_size in arena
+ * mode) except for the last one; it returns false on failure.
+ */
+typedef struct {
+    bool (*write)(void* ctx, const void* data, size_t len);
+    void (*close)(void* ctx);    // optional, called once by pcap_writer_close()
+    void* ctx;
+} pcap_writer_sink_t;
+
 /**
- * @brief Initialize a new PCAP file at the given path.
- *        Writes the global PCAP header.
+ * @brief Create a PCAP file at the given path and write the global header
+ *        (pcapng: section header and interface description blocks).
  * @param filename Absolute path (e.g., "/spiffs/handshake.pcap")
+ * @param config   Writer settings, or NULL for PCAP_WRITER_DEFAULT_CONFIG().
+ * @return Writer handle, or NULL on failure.
+ */
+pcap_writer_t* pcap_writer_open(const char* filename, const pcap_writer_config_t* config);
+
+/**
+ * @brief Like pcap_writer_open(), but hand the output to a sink instead of a file.
+ */
+pcap_writer_t* pcap_writer_open_sink(const pcap_writer_sink_t* sink, const pcap_writer_config_t* config);
+
+/*
+ * Arena mode: with config->arena set, the capture is recorded straight into
+ * that memory and the file is neither created nor written until the arena
+ * fills (its contents are then committed and recording starts over at the
+ * beginning of the arena) or the writer is closed. pcap_writer_poll() never
+ * touches the file in this mode. If the stats show bytes == 0 just before
+ * close, the arena holds the complete file in [0, pending) and stays valid
+ * after close until the caller reuses it.
+ */
+
+/**
+ * @brief Same as pcap_writer_open() with the default configuration.
+ */
+pcap_writer_t* pcap_writer_init(const char* filename);
+
+/**
+ * @brief Append a packet captured at a given time.
+ * @param ts       Capture timestamp.
+ * @param data     Captured bytes.
+ * @param incl_len Number of captured bytes in data.
+ * @param orig_len Length of the packet on the wire (≥ incl_len).
  * @return true on success, false on failure.
+ *
+ * Header and payload are coalesced into the write buffer; the file is only
+ * written when the buffer fills or a flush is requested.
+ */
+bool pcap_writer_write_packet(pcap_writer_t* writer, const struct timeval* ts,
+                              const uint8_t* data, uint32_t incl_len, uint32_t orig_len);
+
+/**
+ * @brief Same as pcap_writer_write_packet(), with the frame's receive conditions.
+ * @param radio Written as a radiotap header on radiotap links, ignored otherwise.
+ *              May be NULL (an empty radiotap header is written).
  */
-bool pcap_writer_init(const char* filename);
+bool pcap_writer_write_frame(pcap_writer_t* writer, const struct timeval* ts,
+                             const pcap_radio_info_t* radio,
+                             const uint8_t* data, uint32_t incl_len, uint32_t orig_len);
 
 /**
- * @brief Append a single 802.11 packet (raw bytes) to the PCAP file.
+ * @brief Append a single 802.11 packet (raw bytes), timestamped now.
  * @param data   Pointer to raw 802.11 frame (header + payload).
  * @param length Length of data in bytes.
  * @return true on success, false on failure.
  */
-bool pcap_writer_write_packet(const uint8_t* data, uint32_t length);
+bool pcap_writer_write(pcap_writer_t* writer, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief Write out everything buffered so far.
+ */
+bool pcap_writer_flush(pcap_writer_t* writer);
+
+/**
+ * @brief Flush if buffered data is older than flush_interval_ms. Call periodically.
+ */
+bool pcap_writer_poll(pcap_writer_t* writer);
+
+/**
+ * @brief Copy the writer's counters.
+ */
+void pcap_writer_get_stats(const pcap_writer_t* writer, pcap_writer_stats_t* out);
 
 /**
- * @brief Close the PCAP file (flush and fclose).
+ * @brief Flush, close the file and free the handle.
  */
-void pcap_writer_close(void);
+void pcap_writer_close(pcap_writer_t* writer);
 
 #ifdef __cplusplus
 }
@@ -1,11 +1,21 @@
 /**
  * pcap_writer.c
  *
- * Minimal PCAP writer for ESP32 using standard fopen/fwrite on SPIFFS.
+ * Minimal PCAP / pcapng writer for ESP32 using standard fopen/fwrite on SPIFFS.
+ *
+ * Each writer coalesces packet headers and payloads into one block-sized
+ * buffer, so the file sees a few large, sector-sized writes instead of two
+ * small writes per packet. In arena mode the buffer is a large caller-owned
+ * (typically PSRAM) region, and the file is only created and written when
+ * it fills or the writer closes. On radiotap links a compact radiotap header
+ * (rate or MCS, channel, signal, noise) is built in front of every frame.
  */
 
 #include "pcap_writer.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
 
@@ -28,71 +38,479 @@ typedef struct {
     uint32_t orig_len;   // actual length of packet
 } pcap_packet_header_t;
 
+// pcapng block types and options
+#define PCAPNG_BT_SHB         0x0a0d0d0a
+#define PCAPNG_BT_IDB         0x00000001
+#define PCAPNG_BT_EPB         0x00000006
+#define PCAPNG_BYTE_ORDER     0x1a2b3c4d
+#define PCAPNG_OPT_END        0
+#define PCAPNG_OPT_SHB_USERAPPL  4
+#define PCAPNG_OPT_IF_NAME       2
+#define PCAPNG_OPT_IF_DESC       3
+
+// Section Header Block body, after type and length
+typedef struct {
+    uint32_t byte_order_magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int64_t  section_length;   // -1: not specified
+} __attribute__((packed)) pcapng_shb_t;
+
+// Interface Description Block body
+typedef struct {
+    uint16_t linktype;
+    uint16_t reserved;
+    uint32_t snaplen;
+} pcapng_idb_t;
+
+// Enhanced Packet Block body, before the packet data
+typedef struct {
+    uint32_t interface_id;
+    uint32_t ts_high;          // microseconds since the epoch (if_tsresol default)
+    uint32_t ts_low;
+    uint32_t cap_len;
+    uint32_t orig_len;
+} pcapng_epb_t;
+
+// Radiotap present bits
+#define RT_RATE         (1u << 2)
+#define RT_CHANNEL      (1u << 3)
+#define RT_DBM_SIGNAL   (1u << 5)
+#define RT_DBM_NOISE    (1u << 6)
+#define RT_MCS          (1u << 19)
+
+#define RT_CHAN_2GHZ    0x0080
+#define RT_CHAN_5GHZ    0x0100
+#define RT_MCS_KNOWN    0x07   // bandwidth, MCS index and guard interval are valid
+#define RT_MCS_BW40     0x01
+#define RT_MCS_SGI      0x04
+
+struct pcap_writer {
+    pcap_writer_sink_t sink;    // where full buffers go (the file sink below by default)
+    FILE*    file;
+    char*    path;              // arena mode: file to create on first commit
+    uint8_t* buf;
+    size_t   cap;
+    size_t   used;
+    bool     owns_buf;
+    bool     arena;
+    int64_t  first_us;          // when the oldest buffered byte was added
+    int64_t  flush_interval_us;
+    uint32_t snaplen;
+    bool     radiotap;
+    bool     pcapng;
+    void   (*on_flush)(void* ctx, size_t len, bool ok, uint32_t cycles);
+    void*    on_flush_ctx;
+    pcap_writer_stats_t stats;
+};
+
 static const char* TAG = "pcap_writer";
-static FILE* pcap_file = NULL;
 
-bool pcap_writer_init(const char* filename)
+static bool open_file(pcap_writer_t* w, const char* filename)
 {
+    if (!filename) {
+        return false;
+    }
     // Open for writing (binary), truncating if exists
-    pcap_file = fopen(filename, "wb");
-    if (!pcap_file) {
+    w->file = fopen(filename, "wb");
+    if (!w->file) {
         ESP_LOGE(TAG, "Failed to fopen(%s)", filename);
         return false;
     }
+    // We already write whole blocks; stdio buffering would only add a copy
+    setvbuf(w->file, NULL, _IONBF, 0);
+    return true;
+}
 
-    pcap_global_header_t gh = {
-        .magic_number = 0xa1b2c3d4,
-        .version_major = 2,
-        .version_minor = 4,
-        .thiszone = 0,
-        .sigfigs = 0,
-        .snaplen = 0x0000ffff,    // max packet length
-        .network = 105            // LINKTYPE_IEEE802_11
-    };
-
-    size_t w = fwrite(&gh, sizeof(gh), 1, pcap_file);
-    if (w != 1) {
-        ESP_LOGE(TAG, "Write PCAP global header failed");
-        fclose(pcap_file);
-        pcap_file = NULL;
+// File sink: ctx is the writer; in arena mode the file is only created here
+static bool file_sink_write(void* ctx, const void* data, size_t len)
+{
+    pcap_writer_t* w = ctx;
+    if (!w->file && !open_file(w, w->path)) {
+        return false;
+    }
+    size_t n = fwrite(data, 1, len, w->file);
+    if (n != len) {
+        ESP_LOGE(TAG, "Short write (%u of %u bytes)", (unsigned)n, (unsigned)len);
         return false;
     }
-    ESP_LOGI(TAG, "PCAP file initialized: %s", filename);
     return true;
 }
 
-bool pcap_writer_write_packet(const uint8_t* data, uint32_t length)
+static void file_sink_close(void* ctx)
+{
+    pcap_writer_t* w = ctx;
+    if (w->file) {
+        fclose(w->file);
+        w->file = NULL;
+    }
+}
+
+static bool flush_buffer(pcap_writer_t* w)
+{
+    if (w->used == 0) {
+        return true;
+    }
+    uint32_t start = (uint32_t)esp_cpu_get_cycle_count();
+    bool ok = w->sink.write(w->sink.ctx, w->buf, w->used);
+    if (w->on_flush) {
+        w->on_flush(w->on_flush_ctx, w->used, ok, (uint32_t)esp_cpu_get_cycle_count() - start);
+    }
+    w->stats.flushes++;
+    if (ok) {
+        w->stats.bytes += w->used;
+    } else {
+        w->stats.errors++;
+    }
+    w->used = 0;
+    return ok;
+}
+
+static bool buffer_append(pcap_writer_t* w, const void* src, size_t len)
+{
+    const uint8_t* p = src;
+    if (w->used == 0 && len > 0) {
+        w->first_us = esp_timer_get_time();
+    }
+    while (len > 0) {
+        size_t n = w->cap - w->used;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(w->buf + w->used, p, n);
+        w->used += n;
+        p += n;
+        len -= n;
+        if (w->used == w->cap) {
+            if (!flush_buffer(w)) {
+                return false;
+            }
+            if (len > 0) {
+                w->first_us = esp_timer_get_time();
+            }
+        }
+    }
+    return true;
+}
+
+static inline void put_le16(uint8_t* p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+/**
+ * @brief Build the radiotap header for one frame.
+ * @return Header length (at most PCAP_RADIOTAP_MAX_LEN).
+ */
+static size_t build_radiotap(uint8_t* rt, const pcap_radio_info_t* radio)
+{
+    uint32_t present = 0;
+    size_t off = 8;
+    if (radio) {
+        if (radio->mcs == PCAP_RADIO_NO_MCS && radio->rate) {
+            present |= RT_RATE;
+            rt[off++] = radio->rate;
+        }
+        if (radio->freq_mhz) {
+            present |= RT_CHANNEL;
+            if (off & 1) {
+                rt[off++] = 0;              // u16 fields are 2-byte aligned
+            }
+            put_le16(rt + off, radio->freq_mhz);
+            put_le16(rt + off + 2, radio->freq_mhz < 5000 ? RT_CHAN_2GHZ : RT_CHAN_5GHZ);
+            off += 4;
+        }
+        present |= RT_DBM_SIGNAL;
+        rt[off++] = (uint8_t)radio->rssi;
+        if (radio->noise) {
+            present |= RT_DBM_NOISE;
+            rt[off++] = (uint8_t)radio->noise;
+        }
+        if (radio->mcs != PCAP_RADIO_NO_MCS) {
+            present |= RT_MCS;
+            rt[off++] = RT_MCS_KNOWN;
+            rt[off++] = (radio->bw40 ? RT_MCS_BW40 : 0) | (radio->sgi ? RT_MCS_SGI : 0);
+            rt[off++] = radio->mcs;
+        }
+    }
+    rt[0] = 0;   // version
+    rt[1] = 0;   // pad
+    put_le16(rt + 2, off);
+    put_le16(rt + 4, present & 0xffff);
+    put_le16(rt + 6, present >> 16);
+    return off;
+}
+
+// Append a pcapng option; values are padded to 32 bits
+static void append_option(pcap_writer_t* w, uint16_t code, const char* value)
+{
+    static const uint8_t pad[4] = {0};
+    size_t len = strlen(value);
+    uint16_t hdr[2] = { code, (uint16_t)len };
+    buffer_append(w, hdr, sizeof(hdr));
+    buffer_append(w, value, len);
+    buffer_append(w, pad, (4 - (len & 3)) & 3);
+}
+
+static inline uint32_t option_size(const char* value)
+{
+    return value ? 4 + ((strlen(value) + 3) & ~3u) : 0;
+}
+
+static void write_pcapng_header(pcap_writer_t* w, const pcap_writer_config_t* config)
+{
+    static const char userappl[] = "esp32_wifi_entest";
+    uint32_t end_opt = PCAPNG_OPT_END;
+
+    pcapng_shb_t shb = {
+        .byte_order_magic = PCAPNG_BYTE_ORDER,
+        .version_major = 1,
+        .version_minor = 0,
+        .section_length = -1,
+    };
+    uint32_t len = 12 + sizeof(shb) + option_size(userappl) + 4;
+    uint32_t hdr[2] = { PCAPNG_BT_SHB, len };
+    buffer_append(w, hdr, sizeof(hdr));
+    buffer_append(w, &shb, sizeof(shb));
+    append_option(w, PCAPNG_OPT_SHB_USERAPPL, userappl);
+    buffer_append(w, &end_opt, sizeof(end_opt));
+    buffer_append(w, &len, sizeof(len));
+
+    pcapng_idb_t idb = {
+        .linktype = (uint16_t)config->linktype,
+        .reserved = 0,
+        .snaplen = w->snaplen + (w->radiotap ? PCAP_RADIOTAP_MAX_LEN : 0),
+    };
+    len = 12 + sizeof(idb) + option_size(config->if_name) + option_size(config->if_description) + 4;
+    hdr[0] = PCAPNG_BT_IDB;
+    hdr[1] = len;
+    buffer_append(w, hdr, sizeof(hdr));
+    buffer_append(w, &idb, sizeof(idb));
+    if (config->if_name) {
+        append_option(w, PCAPNG_OPT_IF_NAME, config->if_name);
+    }
+    if (config->if_description) {
+        append_option(w, PCAPNG_OPT_IF_DESC, config->if_description);
+    }
+    buffer_append(w, &end_opt, sizeof(end_opt));
+    buffer_append(w, &len, sizeof(len));
+}
+
+static void writer_free(pcap_writer_t* w)
+{
+    if (w->owns_buf) {
+        free(w->buf);
+    }
+    free(w->path);
+    free(w);
+}
+
+/**
+ * @brief Allocate a writer and its buffer (or adopt the arena); no output yet.
+ */
+static pcap_writer_t* writer_alloc(const pcap_writer_config_t* config)
+{
+    pcap_writer_t* w = calloc(1, sizeof(*w));
+    if (!w) {
+        return NULL;
+    }
+    w->flush_interval_us = (int64_t)config->flush_interval_ms * 1000;
+    w->snaplen = config->snaplen;
+    w->radiotap = (config->linktype == PCAP_LINKTYPE_IEEE802_11_RADIOTAP);
+    w->pcapng = (config->format == PCAP_WRITER_FORMAT_PCAPNG);
+    w->on_flush = config->on_flush;
+    w->on_flush_ctx = config->on_flush_ctx;
+
+    if (config->arena) {
+        if (config->arena_size < PCAP_WRITER_BLOCK_SIZE) {
+            free(w);
+            return NULL;
+        }
+        w->buf = config->arena;
+        w->cap = config->arena_size;
+        w->arena = true;
+    } else {
+        w->cap = (config->buffer_size + PCAP_WRITER_BLOCK_SIZE - 1) & ~(size_t)(PCAP_WRITER_BLOCK_SIZE - 1);
+        if (w->cap == 0) {
+            w->cap = PCAP_WRITER_BLOCK_SIZE;
+        }
+        w->buf = malloc(w->cap);
+        if (!w->buf) {
+            ESP_LOGE(TAG, "No memory for %u-byte write buffer", (unsigned)w->cap);
+            free(w);
+            return NULL;
+        }
+        w->owns_buf = true;
+    }
+    return w;
+}
+
+static void write_file_header(pcap_writer_t* w, const pcap_writer_config_t* config)
+{
+    if (w->pcapng) {
+        write_pcapng_header(w, config);
+    } else {
+        pcap_global_header_t gh = {
+            .magic_number = 0xa1b2c3d4,
+            .version_major = 2,
+            .version_minor = 4,
+            .thiszone = 0,
+            .sigfigs = 0,
+            .snaplen = config->snaplen + (w->radiotap ? PCAP_RADIOTAP_MAX_LEN : 0),
+            .network = config->linktype
+        };
+        buffer_append(w, &gh, sizeof(gh));
+    }
+}
+
+pcap_writer_t* pcap_writer_open(const char* filename, const pcap_writer_config_t* config)
+{
+    const pcap_writer_config_t defaults = PCAP_WRITER_DEFAULT_CONFIG();
+    if (!config) {
+        config = &defaults;
+    }
+
+    pcap_writer_t* w = writer_alloc(config);
+    if (!w) {
+        return NULL;
+    }
+    w->sink = (pcap_writer_sink_t){ .write = file_sink_write, .close = file_sink_close, .ctx = w };
+    if (w->arena ? !(w->path = strdup(filename)) : !open_file(w, filename)) {
+        writer_free(w);
+        return NULL;
+    }
+    write_file_header(w, config);
+
+    ESP_LOGI(TAG, "%s file initialized: %s (linktype %u%s)", w->pcapng ? "pcapng" : "PCAP",
+             filename, (unsigned)config->linktype, w->arena ? ", RAM arena" : "");
+    return w;
+}
+
+pcap_writer_t* pcap_writer_open_sink(const pcap_writer_sink_t* sink, const pcap_writer_config_t* config)
+{
+    const pcap_writer_config_t defaults = PCAP_WRITER_DEFAULT_CONFIG();
+    if (!config) {
+        config = &defaults;
+    }
+
+    pcap_writer_t* w = writer_alloc(config);
+    if (!w) {
+        return NULL;
+    }
+    w->sink = *sink;
+    write_file_header(w, config);
+    return w;
+}
+
+pcap_writer_t* pcap_writer_init(const char* filename)
+{
+    return pcap_writer_open(filename, NULL);
+}
+
+bool pcap_writer_write_frame(pcap_writer_t* w, const struct timeval* ts,
+                             const pcap_radio_info_t* radio,
+                             const uint8_t* data, uint32_t incl_len, uint32_t orig_len)
 {
-    if (!pcap_file) {
+    if (!w) {
         return false;
     }
+    if (incl_len > w->snaplen) {
+        incl_len = w->snaplen;
+    }
+
+    uint8_t rt[PCAP_RADIOTAP_MAX_LEN];
+    size_t rt_len = w->radiotap ? build_radiotap(rt, radio) : 0;
+    uint32_t cap_len = rt_len + incl_len;
+
+    bool ok;
+    if (w->pcapng) {
+        static const uint8_t pad[4] = {0};
+        uint32_t pad_len = (4 - (cap_len & 3)) & 3;
+        uint32_t block_len = 12 + sizeof(pcapng_epb_t) + cap_len + pad_len;
+        uint64_t ts_us = (uint64_t)ts->tv_sec * 1000000 + ts->tv_usec;
+        uint32_t hdr[2] = { PCAPNG_BT_EPB, block_len };
+        pcapng_epb_t epb = {
+            .interface_id = 0,
+            .ts_high = (uint32_t)(ts_us >> 32),
+            .ts_low = (uint32_t)ts_us,
+            .cap_len = cap_len,
+            .orig_len = rt_len + orig_len,
+        };
+        ok = buffer_append(w, hdr, sizeof(hdr)) && buffer_append(w, &epb, sizeof(epb)) &&
+             buffer_append(w, rt, rt_len) && buffer_append(w, data, incl_len) &&
+             buffer_append(w, pad, pad_len) && buffer_append(w, &block_len, sizeof(block_len));
+    } else {
+        pcap_packet_header_t ph = {
+            .ts_sec = ts->tv_sec,
+            .ts_usec = ts->tv_usec,
+            .incl_len = cap_len,
+            .orig_len = rt_len + orig_len
+        };
+        ok = buffer_append(w, &ph, sizeof(ph)) && buffer_append(w, rt, rt_len) &&
+             buffer_append(w, data, incl_len);
+    }
+    if (!ok) {
+        return false;
+    }
+    w->stats.packets++;
+    return pcap_writer_poll(w);
+}
+
+bool pcap_writer_write_packet(pcap_writer_t* w, const struct timeval* ts,
+                              const uint8_t* data, uint32_t incl_len, uint32_t orig_len)
+{
+    return pcap_writer_write_frame(w, ts, NULL, data, incl_len, orig_len);
+}
 
+bool pcap_writer_write(pcap_writer_t* w, const uint8_t* data, uint32_t length)
+{
     struct timeval tv;
     gettimeofday(&tv, NULL);
+    return pcap_writer_write_packet(w, &tv, data, length, length);
+}
 
-    pcap_packet_header_t ph = {
-        .ts_sec = tv.tv_sec,
-        .ts_usec = tv.tv_usec,
-        .incl_len = length,
-        .orig_len = length
-    };
-
-    if (fwrite(&ph, sizeof(ph), 1, pcap_file) != 1) {
-        ESP_LOGE(TAG, "Failed to write packet header");
+bool pcap_writer_flush(pcap_writer_t* w)
+{
+    if (!w) {
         return false;
     }
-    if (fwrite(data, length, 1, pcap_file) != 1) {
-        ESP_LOGE(TAG, "Failed to write packet data");
+    // Files are unbuffered (_IONBF), so this reaches the VFS directly
+    return flush_buffer(w);
+}
+
+bool pcap_writer_poll(pcap_writer_t* w)
+{
+    if (!w) {
         return false;
     }
-    return true;
+    if (w->arena || w->used == 0 || esp_timer_get_time() - w->first_us < w->flush_interval_us) {
+        return true;
+    }
+    return flush_buffer(w);
 }
 
-void pcap_writer_close(void)
+void pcap_writer_get_stats(const pcap_writer_t* w, pcap_writer_stats_t* out)
 {
-    if (pcap_file) {
-        fclose(pcap_file);
-        pcap_file = NULL;
-        ESP_LOGI(TAG, "PCAP file closed");
+    if (w) {
+        *out = w->stats;
+        out->pending = w->used;
+    } else {
+        memset(out, 0, sizeof(*out));
+    }
+}
+
+void pcap_writer_close(pcap_writer_t* w)
+{
+    if (!w) {
+        return;
+    }
+    // Arena mode: flush_buffer() only copies out, so the arena is left intact
+    flush_buffer(w);
+    if (w->sink.close) {
+        w->sink.close(w->sink.ctx);
     }
+    ESP_LOGI(TAG, "PCAP file closed (%u packets, %u bytes, %u writes)",
+             (unsigned)w->stats.packets, (unsigned)w->stats.bytes, (unsigned)w->stats.flushes);
+    writer_free(w);
 }
@@ -0,0 +1,686 @@
+/**
+ * bench.c
+ *
+ * Replays 802.11 captures through the capture-path components on the host:
+ *  - classify: frame_filter_classify() over every frame (RX callback work),
+ *              unrestricted and with the target set holding one BSSID
+ *  - dedup:    frame_dedup_seen() over every frame (writer task work)
+ *  - bss:      bss_table_observe() over every frame at the scan cache's
+ *              default limits, which the synthetic channel overflows
+ *              (RX callback work, under the cache's spinlock)
+ *  - eapol:    eapol_parse() + tracker + hashcat 22000 for the frames kept as
+ *              EAPOL (writer task work)
+ *  - write:    pcap_writer into a file, a RAM arena and a counting sink,
+ *              pcap and pcapng/radiotap
+ *
+ * Input is classic pcap or pcapng with raw 802.11 (105) or radiotap (127)
+ * frames; radiotap headers and FCS are stripped so the components see what
+ * the promiscuous callback delivers. Without input files a synthetic busy
+ * channel (data-heavy, 32 BSSes, periodic handshakes, a few retries) is
+ * generated.
+ *
+ * Reports frames/s, MB/s and heap allocations per pass for each stage.
+ */
+
+#include "pcap_writer.h"
+#include "frame_filter.h"
+#include "eapol_tracker.h"
+#include "hc22000.h"
+#include "frame_dedup.h"
+#include "bss_table.h"
+#include "ieee80211.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Heap accounting (see --wrap in CMakeLists.txt)
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t size);
+void  __real_free(void* p);
+
+static size_t s_allocs;
+static size_t s_alloc_bytes;
+
+void* __wrap_malloc(size_t size)
+{
+    s_allocs++;
+    s_alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size)
+{
+    s_allocs++;
+    s_alloc_bytes += n * size;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* p, size_t size)
+{
+    s_allocs++;
+    s_alloc_bytes += size;
+    return __real_realloc(p, size);
+}
+
+void __wrap_free(void* p)
+{
+    __real_free(p);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Frame set
+
+typedef struct {
+    uint32_t off;    // into frame_set_t::data
+    uint16_t len;
+} frame_ref_t;
+
+typedef struct {
+    uint8_t*     data;
+    size_t       data_len, data_cap;
+    frame_ref_t* frames;
+    size_t       count, cap;
+    size_t       bytes;   // sum of frame lengths
+} frame_set_t;
+
+static void add_frame(frame_set_t* set, const uint8_t* frame, size_t len)
+{
+    if (len == 0 || len > 0xffff) {
+        return;
+    }
+    if (set->data_len + len > set->data_cap) {
+        set->data_cap = (set->data_cap + len) * 2;
+        set->data = __real_realloc(set->data, set->data_cap);
+    }
+    if (set->count == set->cap) {
+        set->cap = set->cap ? set->cap * 2 : 1024;
+        set->frames = __real_realloc(set->frames, set->cap * sizeof(frame_ref_t));
+    }
+    if (!set->data || !set->frames) {
+        fprintf(stderr, "Out of memory loading frames\n");
+        exit(1);
+    }
+    memcpy(set->data + set->data_len, frame, len);
+    set->frames[set->count++] = (frame_ref_t){ .off = (uint32_t)set->data_len, .len = (uint16_t)len };
+    set->data_len += len;
+    set->bytes += len;
+}
+
+static inline const uint8_t* frame_at(const frame_set_t* set, size_t i)
+{
+    return set->data + set->frames[i].off;
+}
+
+static uint16_t get16(const uint8_t* p, bool swap)
+{
+    return swap ? (uint16_t)(p[0] << 8 | p[1]) : (uint16_t)(p[1] << 8 | p[0]);
+}
+
+static uint32_t get32(const uint8_t* p, bool swap)
+{
+    return swap ? (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]
+                : (uint32_t)p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+#define RT_PRESENT_TSFT    0x00000001
+#define RT_PRESENT_FLAGS   0x00000002
+#define RT_PRESENT_EXT     0x80000000
+#define RT_FLAGS_FCS       0x10
+
+/**
+ * @brief Turn one captured record into the MPDU the promiscuous callback sees.
+ */
+static void add_record(frame_set_t* set, uint32_t linktype, const uint8_t* p, size_t len)
+{
+    bool fcs = false;
+    if (linktype == PCAP_LINKTYPE_IEEE802_11_RADIOTAP) {
+        if (len < 8) {
+            return;
+        }
+        uint16_t rt_len = get16(p + 2, false);
+        uint32_t present = get32(p + 4, false);
+        size_t off = 8;
+        for (uint32_t ext = present; (ext & RT_PRESENT_EXT) && off + 4 <= rt_len; off += 4) {
+            ext = get32(p + off, false);
+        }
+        if (present & RT_PRESENT_TSFT) {
+            off = ((off + 7) & ~(size_t)7) + 8;
+        }
+        if ((present & RT_PRESENT_FLAGS) && off < rt_len) {
+            fcs = p[off] & RT_FLAGS_FCS;
+        }
+        if (rt_len > len) {
+            return;
+        }
+        p += rt_len;
+        len -= rt_len;
+    } else if (linktype != PCAP_LINKTYPE_IEEE802_11) {
+        return;
+    }
+    if (fcs && len >= 4) {
+        len -= 4;
+    }
+    add_frame(set, p, len);
+}
+
+static uint8_t* read_file(const char* path, size_t* len)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* buf = size > 0 ? __real_malloc(size) : NULL;
+    if (!buf || fread(buf, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        __real_free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *len = size;
+    return buf;
+}
+
+static bool load_pcap(frame_set_t* set, const uint8_t* b, size_t len)
+{
+    uint32_t magic = get32(b, false);
+    bool swap = (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1);
+    uint32_t linktype = get32(b + 20, swap);
+    for (size_t off = 24; off + 16 <= len;) {
+        uint32_t incl = get32(b + off + 8, swap);
+        if (off + 16 + incl > len) {
+            break;
+        }
+        add_record(set, linktype, b + off + 16, incl);
+        off += 16 + incl;
+    }
+    return true;
+}
+
+#define PCAPNG_SHB   0x0a0d0d0a
+#define PCAPNG_IDB   0x00000001
+#define PCAPNG_EPB   0x00000006
+#define PCAPNG_MAX_IF 16
+
+static bool load_pcapng(frame_set_t* set, const uint8_t* b, size_t len)
+{
+    uint32_t linktypes[PCAPNG_MAX_IF] = {0};
+    uint32_t if_count = 0;
+    bool swap = false;
+    for (size_t off = 0; off + 12 <= len;) {
+        if (get32(b + off, false) == PCAPNG_SHB) {
+            swap = get32(b + off + 8, false) != 0x1a2b3c4d;
+            if_count = 0;
+        }
+        uint32_t type = get32(b + off, swap);
+        uint32_t block_len = get32(b + off + 4, swap);
+        if (block_len < 12 || off + block_len > len) {
+            break;
+        }
+        if (type == PCAPNG_IDB && if_count < PCAPNG_MAX_IF) {
+            linktypes[if_count++] = get16(b + off + 8, swap);
+        } else if (type == PCAPNG_EPB && block_len >= 32) {
+            uint32_t if_id = get32(b + off + 8, swap);
+            uint32_t incl = get32(b + off + 20, swap);
+            if (if_id < if_count && 28 + incl <= block_len) {
+                add_record(set, linktypes[if_id], b + off + 28, incl);
+            }
+        }
+        off += block_len;
+    }
+    return true;
+}
+
+static bool load_capture(frame_set_t* set, const char* path)
+{
+    size_t len;
+    uint8_t* b = read_file(path, &len);
+    if (!b) {
+        return false;
+    }
+    bool ok = false;
+    uint32_t magic = len >= 24 ? get32(b, false) : 0;
+    if (magic == PCAPNG_SHB) {
+        ok = load_pcapng(set, b, len);
+    } else if (magic == 0xa1b2c3d4 || magic == 0xd4c3b2a1 || magic == 0xa1b23c4d || magic == 0x4d3cb2a1) {
+        ok = load_pcap(set, b, len);
+    } else {
+        fprintf(stderr, "%s: not a pcap or pcapng file\n", path);
+    }
+    __real_free(b);
+    return ok;
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Synthetic channel
+
+#define SYN_BSS      32
+#define SYN_FRAMES   200000
+
+static uint32_t s_rng = 0x12345678;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void mac_for(uint8_t mac[6], uint32_t bss, uint32_t sta)
+{
+    mac[0] = sta ? 0x02 : 0x00;
+    mac[1] = 0x11;
+    mac[2] = 0x22;
+    mac[3] = (uint8_t)bss;
+    mac[4] = (uint8_t)(sta >> 8);
+    mac[5] = (uint8_t)sta;
+}
+
+static size_t syn_beacon(uint8_t* f, uint32_t bss)
+{
+    memset(f, 0, 64);
+    f[0] = IEEE80211_SUBTYPE_BEACON << 4;
+    memset(f + 4, 0xff, 6);
+    mac_for(f + 10, bss, 0);
+    mac_for(f + 16, bss, 0);
+    size_t off = IEEE80211_HDR_LEN + IEEE80211_BEACON_FIXED_LEN;
+    int n = snprintf((char*)f + off + 2, 33, "bench-net-%02u", (unsigned)bss);
+    f[off] = IEEE80211_IE_SSID;
+    f[off + 1] = (uint8_t)n;
+    off += 2 + n;
+    memset(f + off, 0xdd, 120);   // rates, DS, TIM, RSN, vendor IEs
+    return off + 120;
+}
+
+static size_t syn_data(uint8_t* f, uint32_t bss, uint32_t sta, size_t body)
+{
+    f[0] = (IEEE80211_TYPE_DATA << 2) | (IEEE80211_SUBTYPE_QOS_BIT << 4);
+    f[1] = IEEE80211_FC1_TODS | IEEE80211_FC1_PROTECTED;
+    mac_for(f + 4, bss, 0);
+    mac_for(f + 10, bss, sta);
+    mac_for(f + 16, bss, 0);
+    size_t hdr = ieee80211_data_hdr_len(f);
+    for (size_t i = 0; i < body; i++) {
+        f[hdr + i] = (uint8_t)rnd();
+    }
+    return hdr + body;
+}
+
+static size_t syn_eapol(uint8_t* f, uint32_t bss, uint32_t sta, int msg, uint64_t replay)
+{
+    static const uint8_t llc[8] = { 0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00, 0x88, 0x8e };
+    static const uint16_t key_info[5] = { 0, 0x008a, 0x010a, 0x13ca, 0x030a };
+    bool from_ap = (msg == 1 || msg == 3);
+    memset(f, 0, 256);
+    f[0] = (IEEE80211_TYPE_DATA << 2) | (IEEE80211_SUBTYPE_QOS_BIT << 4);
+    f[1] = from_ap ? IEEE80211_FC1_FROMDS : IEEE80211_FC1_TODS;
+    mac_for(f + 4, bss, from_ap ? sta : 0);
+    mac_for(f + 10, bss, from_ap ? 0 : sta);
+    mac_for(f + 16, bss, 0);
+    size_t off = ieee80211_data_hdr_len(f);
+    memcpy(f + off, llc, sizeof(llc));
+    uint8_t* e = f + off + sizeof(llc);
+    uint16_t kd_len = (msg == 2) ? 22 : (msg == 3) ? 56 : 0;
+    uint16_t body = 95 + kd_len;
+    e[0] = 2;
+    e[1] = EAPOL_TYPE_KEY;
+    e[2] = body >> 8;
+    e[3] = (uint8_t)body;
+    e[4] = 2;                                   // RSN key descriptor
+    e[5] = key_info[msg] >> 8;
+    e[6] = (uint8_t)key_info[msg];
+    e[8] = 16;                                  // key length
+    for (int i = 0; i < 8; i++) {
+        e[9 + i] = (uint8_t)(replay >> (56 - 8 * i));
+    }
+    for (int i = 0; i < EAPOL_NONCE_LEN; i++) {
+        e[17 + i] = (uint8_t)(msg == 4 ? 0 : rnd());
+    }
+    if (msg != 1) {
+        for (int i = 0; i < EAPOL_MIC_LEN; i++) {
+            e[81 + i] = (uint8_t)rnd();
+        }
+    }
+    e[97] = kd_len >> 8;
+    e[98] = (uint8_t)kd_len;
+    memset(e + 99, 0x30, kd_len);
+    return off + sizeof(llc) + EAPOL_HDR_LEN + body;
+}
+
+static void synthesize(frame_set_t* set)
+{
+    uint8_t f[2048];
+    uint64_t replay = 1;
+    for (size_t n = 0; n < SYN_FRAMES;) {
+        uint32_t r = rnd() % 1000;
+        uint32_t bss = rnd() % SYN_BSS;
+        uint32_t sta = 1 + rnd() % 16;
+        if (r < 120) {
+            add_frame(set, f, syn_beacon(f, bss));
+            n++;
+        } else if (r < 122) {
+            for (int msg = 1; msg <= 4; msg++, n++) {
+                add_frame(set, f, syn_eapol(f, bss, sta, msg, msg >= 3 ? replay + 1 : replay));
+            }
+            replay += 2;
+        } else {
+            // Mostly full-size data, some short frames (ACK-sized TCP, ARP…)
+            size_t body = (r % 3) ? 1400 + rnd() % 100 : 40 + rnd() % 80;
+            size_t len = syn_data(f, bss, sta, body);
+            add_frame(set, f, len);
+            n++;
+            // About one in twenty-five is retransmitted unchanged but for the retry bit
+            if (rnd() % 25 == 0 && n < SYN_FRAMES) {
+                f[1] |= IEEE80211_FC1_RETRY;
+                add_frame(set, f, len);
+                n++;
+            }
+        }
+    }
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Benchmarks
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    size_t frames;
+    size_t bytes;
+    size_t allocs;
+    size_t alloc_bytes;
+    double seconds;
+} result_t;
+
+static void report(const char* name, const result_t* r, int passes)
+{
+    printf("%-26s %12.0f %10.1f %10.1f %12.1f\n", name,
+           r->frames / r->seconds, r->bytes / r->seconds / 1e6,
+           (double)r->allocs / passes, (double)r->alloc_bytes / passes);
+}
+
+static void begin(result_t* r)
+{
+    memset(r, 0, sizeof(*r));
+    s_allocs = 0;
+    s_alloc_bytes = 0;
+    r->seconds = now_s();
+}
+
+static void end(result_t* r)
+{
+    r->seconds = now_s() - r->seconds;
+    r->allocs = s_allocs;
+    r->alloc_bytes = s_alloc_bytes;
+}
+
+static volatile size_t s_sink;   // keeps results observable to the optimiser
+
+static void bench_classify_target(const frame_set_t* set, int passes, const uint8_t bssid[6])
+{
+    static frame_filter_t filter;
+    frame_filter_set_targets(&filter, (const uint8_t (*)[6])bssid, 1);
+    result_t r;
+    size_t kept = 0;
+    begin(&r);
+    for (int p = 0; p < passes; p++) {
+        frame_filter_reset(&filter);
+        for (size_t i = 0; i < set->count; i++) {
+            kept += frame_filter_classify(&filter, frame_at(set, i), set->frames[i].len) != FRAME_DROP;
+        }
+    }
+    s_sink += kept;
+    r.frames = set->count * passes;
+    r.bytes = set->bytes * passes;
+    end(&r);
+    report("classify, one target", &r, passes);
+    printf("  (%zu of %zu frames kept per pass, %u foreign)\n",
+           kept / passes, set->count, (unsigned)filter.stats.foreign);
+}
+
+static void bench_classify(const frame_set_t* set, int passes, frame_set_t* eapol, frame_set_t* beacons)
+{
+    static frame_filter_t filter;
+    result_t r;
+    begin(&r);
+    for (int p = 0; p < passes; p++) {
+        frame_filter_reset(&filter);
+        size_t kept = 0;
+        for (size_t i = 0; i < set->count; i++) {
+            frame_verdict_t v = frame_filter_classify(&filter, frame_at(set, i), set->frames[i].len);
+            if (v != FRAME_DROP && p == 0) {
+                add_frame(v == FRAME_KEEP_EAPOL ? eapol : beacons, frame_at(set, i), set->frames[i].len);
+            }
+            kept += (v != FRAME_DROP);
+        }
+        s_sink += kept;
+    }
+    r.frames = set->count * passes;
+    r.bytes = set->bytes * passes;
+    end(&r);
+    report("classify", &r, passes);
+}
+
+static void bench_dedup(const frame_set_t* set, int passes)
+{
+    static frame_dedup_entry_t entries[64];
+    static frame_dedup_t dedup;
+    frame_dedup_init(&dedup, entries, 64, 500);
+    result_t r;
+    begin(&r);
+    for (int p = 0; p < passes; p++) {
+        frame_dedup_reset(&dedup);
+        uint32_t us = 0;
+        for (size_t i = 0; i < set->count; i++) {
+            us += 137;   // same spacing as the write stage
+            s_sink += frame_dedup_seen(&dedup, frame_at(set, i), set->frames[i].len, set->frames[i].len,
+                                       us / 1000);
+        }
+    }
+    r.frames = set->count * passes;
+    r.bytes = set->bytes * passes;
+    end(&r);
+    report("dedup", &r, passes);
+    printf("  (%u of %u frames checked were duplicates per pass)\n",
+           (unsigned)dedup.stats.duplicates, (unsigned)dedup.stats.checked);
+}
+
+// SCAN_CACHE_MAX_APS / SCAN_CACHE_MAX_STATIONS defaults
+#define BENCH_BSS_MAX  32
+#define BENCH_STA_MAX  64
+
+static void bench_bss_table(const frame_set_t* set, int passes)
+{
+    static bss_entry_t bss[128];     // bss_table_slots() of the limits above
+    static bss_station_t sta[128];
+    static bss_table_t table;
+    result_t r;
+    begin(&r);
+    for (int p = 0; p < passes; p++) {
+        memset(bss, 0, sizeof(bss));
+        memset(sta, 0, sizeof(sta));
+        bss_table_init(&table, bss, BENCH_BSS_MAX, sta, BENCH_STA_MAX);
+        int64_t us = 0;
+        for (size_t i = 0; i < set->count; i++) {
+            bss_table_observe(&table, frame_at(set, i), set->frames[i].len, -60, 6, us += 137);
+        }
+        s_sink += table.sta_count;
+    }
+    r.frames = set->count * passes;
+    r.bytes = set->bytes * passes;
+    end(&r);
+    report("bss table, full", &r, passes);
+    printf("  (%u evictions per pass)\n", (unsigned)table.evictions);
+}
+
+static void hc_emit(void* ctx, const char* line, size_t len)
+{
+    s_sink += len;
+}
+
+static void bench_eapol(const frame_set_t* eapol, const frame_set_t* beacons, int passes)
+{
+    static eapol_tracker_t tracker;
+    static hc22000_t hc;
+    result_t r;
+    begin(&r);
+    for (int p = 0; p < passes; p++) {
+        eapol_tracker_reset(&tracker);
+        hc22000_init(&hc, hc_emit, NULL);
+        // Beacons first so the ESSIDs are known, as they would be on air
+        for (size_t i = 0; i < beacons->count; i++) {
+            hc22000_add_beacon(&hc, frame_at(beacons, i), beacons->frames[i].len);
+        }
+        for (size_t i = 0; i < eapol->count; i++) {
+            eapol_key_t key;
+            if (eapol_parse(frame_at(eapol, i), eapol->frames[i].len, &key)) {
+                eapol_tracker_add(&tracker, &key);
+                hc22000_add_key(&hc, &key);
+            }
+        }
+        s_sink += hc.lines;
+    }
+    r.frames = (eapol->count + beacons->count) * passes;
+    r.bytes = (eapol->bytes + beacons->bytes) * passes;
+    end(&r);
+    report("eapol+hc22000", &r, passes);
+    printf("  (%zu EAPOL frames, %zu beacons, %u hashcat lines per pass)\n",
+           eapol->count, beacons->count, (unsigned)hc.lines);
+}
+
+static bool count_sink_write(void* ctx, const void* data, size_t len)
+{
+    *(size_t*)ctx += len;
+    return true;
+}
+
+typedef enum { TO_FILE, TO_ARENA, TO_SINK } target_t;
+
+static void bench_write(const char* name, const frame_set_t* set, int passes, const char* out_path,
+                        target_t target, bool pcapng)
+{
+    static const pcap_radio_info_t radio = {
+        .rssi = -52, .noise = -95, .freq_mhz = 2437, .rate = 108, .mcs = PCAP_RADIO_NO_MCS,
+    };
+    static uint8_t arena[256 * 1024];
+    pcap_writer_config_t cfg = PCAP_WRITER_DEFAULT_CONFIG();
+    cfg.buffer_size = 16 * 1024;
+    cfg.flush_interval_ms = 0xffffffff;
+    if (pcapng) {
+        cfg.format = PCAP_WRITER_FORMAT_PCAPNG;
+        cfg.linktype = PCAP_LINKTYPE_IEEE802_11_RADIOTAP;
+        cfg.if_name = "bench";
+    }
+    if (target == TO_ARENA) {
+        cfg.arena = arena;
+        cfg.arena_size = sizeof(arena);
+    }
+
+    result_t r;
+    size_t out_bytes = 0, frames = 0;
+    begin(&r);
+    for (int p = 0; p < passes; p++) {
+        pcap_writer_t* w;
+        if (target == TO_SINK) {
+            const pcap_writer_sink_t sink = { .write = count_sink_write, .close = NULL, .ctx = &out_bytes };
+            w = pcap_writer_open_sink(&sink, &cfg);
+        } else {
+            w = pcap_writer_open(out_path, &cfg);
+        }
+        if (!w) {
+            fprintf(stderr, "%s: cannot open writer\n", name);
+            return;
+        }
+        struct timeval ts = { .tv_sec = 1700000000 };
+        for (size_t i = 0; i < set->count; i++) {
+            ts.tv_usec = (ts.tv_usec + 137) % 1000000;
+            // A full arena rejects the rest, so stop there to time accepted frames only
+            if (!pcap_writer_write_frame(w, &ts, &radio, frame_at(set, i), set->frames[i].len,
+                                         set->frames[i].len)) {
+                break;
+            }
+            pcap_writer_poll(w);
+        }
+        pcap_writer_stats_t st;
+        pcap_writer_get_stats(w, &st);
+        frames += st.packets;
+        if (target != TO_SINK) {
+            out_bytes += st.bytes + st.pending;
+        }
+        pcap_writer_close(w);
+    }
+    r.frames = frames;
+    r.bytes = out_bytes;
+    end(&r);
+    report(name, &r, passes);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-n passes] [-o out.pcap] [capture.pcap|capture.pcapng ...]\n", prog);
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    int passes = 5;
+    const char* out_path = "pcap_bench.out";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:h")) != -1) {
+        switch (opt) {
+        case 'n': passes = atoi(optarg); break;
+        case 'o': out_path = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (passes < 1) {
+        usage(argv[0]);
+    }
+
+    frame_set_t set = {0}, eapol = {0}, beacons = {0};
+    for (int i = optind; i < argc; i++) {
+        if (!load_capture(&set, argv[i])) {
+            return 1;
+        }
+    }
+    if (optind == argc) {
+        synthesize(&set);
+        printf("Synthetic channel: ");
+    }
+    if (set.count == 0) {
+        fprintf(stderr, "No 802.11 frames found\n");
+        return 1;
+    }
+    printf("%zu frames, %.1f MB, %d passes\n\n", set.count, set.bytes / 1e6, passes);
+    printf("%-26s %12s %10s %10s %12s\n", "stage", "frames/s", "MB/s", "allocs", "alloc bytes");
+
+    bench_classify(&set, passes, &eapol, &beacons);
+    if (eapol.count > 0) {
+        // Target the BSS of the first handshake, as a capture job would
+        bench_classify_target(&set, passes, ieee80211_bssid(frame_at(&eapol, 0)));
+        bench_eapol(&eapol, &beacons, passes);
+    }
+    bench_dedup(&set, passes);
+    bench_bss_table(&set, passes);
+    bench_write("write pcap -> file", &set, passes, out_path, TO_FILE, false);
+    bench_write("write pcapng+rt -> file", &set, passes, out_path, TO_FILE, true);
+    bench_write("write pcapng+rt -> arena", &set, passes, out_path, TO_ARENA, true);
+    bench_write("write pcapng+rt -> sink", &set, passes, out_path, TO_SINK, true);
+    unlink(out_path);
+    return 0;
+}
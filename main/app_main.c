@@ -1,15 +1,21 @@
 /**
  * app_main.c
  *
- * 1. Initialize Wi-Fi STA (join PTCL-BB)
- * 2. Mount SPIFFS (for handshake.pcap)
- * 3. Start HTTP server
+ * 1. Start Wi-Fi STA (join PTCL-BB); association runs in the background
+ * 2. Mount SPIFFS (for the hashcat file) and the raw capture store
+ * 3. Start the capture job task (and a benchmark run, if configured) and the
+ *    background scan cache
+ * 4. Start HTTP server, which answers as soon as the IP arrives
+ * 5. Wait for the IP address
  */
 
 #include <stdio.h>
 #include "esp_log.h"
 #include "wifi_station.h"
 #include "http_server.h"
+#include "capture_job.h"
+#include "scan_cache.h"
+#include "handshake_capture.h"
 #include "esp_vfs_spiffs.h"
 
 static const char* TAG = "app_main";
@@ -18,14 +24,8 @@ void app_main(void)
 {
     ESP_LOGI(TAG, "=== Starting ESP32 Wi-Fi Pentest Tool ===");
 
-    // 1) Connect to Wi-Fi STA (PTCL-BB)
-    if (wifi_init_sta() != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to join Wi-Fi. Halting.");
-        while (1) {
-            vTaskDelay(pdMS_TO_TICKS(1000));
-        }
-    }
-    ESP_LOGI(TAG, "Connected to Wi-Fi, IP: %s", wifi_get_ip_str());
+    // 1) Start joining Wi-Fi STA (PTCL-BB); steps 2-4 overlap with association and DHCP
+    wifi_start_sta();
 
     // 2) Mount SPIFFS (for storing handshake.pcap)
     esp_vfs_spiffs_conf_t conf = {
@@ -41,11 +41,46 @@ void app_main(void)
     }
     ESP_LOGI(TAG, "SPIFFS mounted at /spiffs");
 
-    // 3) Start the HTTP server
+#ifdef CONFIG_CAPTURE_STORE
+    // Captures go to the raw partition; SPIFFS stays the fallback without one
+    capture_store_t* store = NULL;
+    ret = capture_store_mount(CONFIG_CAPTURE_STORE_PARTITION, &store);
+    if (ret == ESP_OK) {
+        handshake_capture_set_store(store);
+    } else {
+        ESP_LOGW(TAG, "Capture store unavailable (%s), using SPIFFS", esp_err_to_name(ret));
+    }
+#endif
+
+    // 3) Start the capture task that runs /attack jobs
+    if (capture_job_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start capture task");
+        return;
+    }
+#ifdef CONFIG_CAPTURE_BENCH_AT_BOOT
+    capture_bench_config_t bench;
+    uint32_t bench_id;
+    capture_bench_default_config(&bench);
+    if (capture_job_submit_bench(&bench, &bench_id) == ESP_OK) {
+        ESP_LOGI(TAG, "Benchmark queued as job %u, see /api/bench", (unsigned)bench_id);
+    }
+#endif
+    if (scan_cache_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start scan cache");
+        return;
+    }
+
+    // 4) Start the HTTP server
     httpd_handle_t server = start_webserver();
     if (!server) {
         ESP_LOGE(TAG, "Failed to start HTTP server");
         return;
     }
+
+    // 5) Wait for the IP address; the driver keeps retrying in the background
+    if (!wifi_wait_connected(15000)) {
+        ESP_LOGW(TAG, "Not connected to %s yet, still trying", CONFIG_WIFI_SSID);
+        wifi_wait_connected(WIFI_WAIT_FOREVER);
+    }
     ESP_LOGI(TAG, "HTTP server running. Visit: http://%s/scan", wifi_get_ip_str());
 }
@@ -0,0 +1,254 @@
+/**
+ * capture_bench.c
+ *
+ * Synthetic load for the capture pipeline. The generator task sits on the
+ * core the Wi-Fi task uses, so the RX side competes for CPU the same way
+ * real traffic does, and hands frames to handshake_capture_inject(); the
+ * writer task, the pcap writer and the flash output are the production ones.
+ *
+ * Per-core load comes from the idle tasks' run-time counters, which needs
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (esp_timer clock) and
+ * CONFIG_FREERTOS_USE_TRACE_FACILITY; without them it is reported as -1.
+ */
+
+#include "capture_bench.h"
+#include "handshake_capture.h"
+#include "capture_metrics.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const char* TAG = "capture_bench";
+
+#define GEN_TASK_STACK  3072
+#define GEN_TASK_PRIO   22      // just below the Wi-Fi task
+#define GEN_TASK_CORE   0       // ESP_WIFI_TASK_PINNED_TO_CORE_0
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY && \
+    CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER
+#define BENCH_CPU_LOAD  1
+#endif
+
+// Synthetic frame layout: QoS data, AP → STA, EAPOL-Key M1
+#define FRAME_HDR_LEN    26
+#define FRAME_EAPOL_OFF  (FRAME_HDR_LEN + 8)   // after the LLC/SNAP header
+#define EAPOL_BODY_MIN   95                    // key descriptor up to the key data length
+
+typedef struct {
+    capture_bench_config_t cfg;
+    size_t            budget;
+    uint32_t          offered;
+    bool              large;         // frames only fit the large slab
+    uint64_t          ring_sum;      // slots in use the frames can take, summed over samples
+    uint32_t          samples;
+    bool              budget_hit;
+    SemaphoreHandle_t done;
+} bench_run_t;
+
+static uint8_t s_frame[CAPTURE_BENCH_MAX_FRAME_LEN];
+
+void capture_bench_default_config(capture_bench_config_t* cfg)
+{
+    cfg->rate = CONFIG_CAPTURE_BENCH_RATE;
+    cfg->frame_len = CONFIG_CAPTURE_BENCH_FRAME_LEN;
+    cfg->duration_ms = CONFIG_CAPTURE_BENCH_DURATION_S * 1000;
+    cfg->spiffs = false;
+}
+
+static void build_frame(uint16_t len)
+{
+    static const uint8_t ap[6]  = { 0x02, 0xbe, 0x4c, 0x00, 0x00, 0x01 };
+    static const uint8_t sta[6] = { 0x02, 0xbe, 0x4c, 0x00, 0x00, 0x02 };
+    static const uint8_t llc[8] = { 0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00, 0x88, 0x8e };
+
+    memset(s_frame, 0, len);
+    s_frame[0] = 0x88;                  // QoS data
+    s_frame[1] = 0x02;                  // FromDS
+    memcpy(s_frame + 4, sta, 6);
+    memcpy(s_frame + 10, ap, 6);
+    memcpy(s_frame + 16, ap, 6);
+    memcpy(s_frame + FRAME_HDR_LEN, llc, sizeof(llc));
+
+    uint8_t* e = s_frame + FRAME_EAPOL_OFF;
+    uint16_t kd_len = len - CAPTURE_BENCH_MIN_FRAME_LEN;
+    uint16_t body = EAPOL_BODY_MIN + kd_len;
+    e[0] = 2;                           // 802.1X-2004
+    e[1] = 3;                           // EAPOL-Key
+    e[2] = body >> 8;
+    e[3] = body & 0xff;
+    e[4] = 2;                           // RSN key descriptor
+    e[5] = 0x00;
+    e[6] = 0x8a;                        // pairwise, ACK, HMAC-SHA1: M1
+    e[8] = 16;
+    for (int i = 0; i < 32; i++) {
+        e[17 + i] = (uint8_t)(i * 37 + 11);   // ANonce
+    }
+    e[97] = kd_len >> 8;
+    e[98] = kd_len & 0xff;
+}
+
+// Each frame is a distinct M1 so the tracker does the same work as on air
+static inline void set_replay(uint32_t n)
+{
+    uint8_t* r = s_frame + FRAME_EAPOL_OFF + 13;   // low half of the replay counter
+    r[0] = n >> 24;
+    r[1] = n >> 16;
+    r[2] = n >> 8;
+    r[3] = n;
+}
+
+static void generator_task(void* arg)
+{
+    bench_run_t* run = arg;
+    const uint32_t tick_ms = portTICK_PERIOD_MS;
+    uint32_t owed = 0;                  // frames due but not injected yet, in 1/1000 frame
+    int64_t end_us = esp_timer_get_time() + (int64_t)run->cfg.duration_ms * 1000;
+    TickType_t wake = xTaskGetTickCount();
+
+    while (esp_timer_get_time() < end_us) {
+        capture_stats_t st;
+        handshake_capture_get_stats(&st);
+        // Frames over the small slot size can only take a large slot
+        uint32_t room = run->large ? st.ring_large_free : st.ring_small_free + st.ring_large_free;
+        run->ring_sum += (run->large ? st.ring_large_slots : st.ring_slots) - room;
+        run->samples++;
+        // Stop while the last buffer still fits, so no older capture is ever evicted
+        if (st.bytes_written + CONFIG_CAPTURE_PCAP_BUFFER_SIZE >= run->budget) {
+            run->budget_hit = true;
+            break;
+        }
+
+        uint32_t n;
+        if (run->cfg.rate == 0) {
+            n = room;
+        } else {
+            owed += run->cfg.rate * tick_ms;
+            n = owed / 1000;
+            owed -= n * 1000;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            set_replay(++run->offered);
+            handshake_capture_inject(s_frame, run->cfg.frame_len);
+        }
+        vTaskDelayUntil(&wake, 1);
+    }
+    xSemaphoreGive(run->done);
+    vTaskDelete(NULL);
+}
+
+#ifdef BENCH_CPU_LOAD
+static void idle_runtime(uint32_t out[CAPTURE_BENCH_MAX_CORES])
+{
+    for (int i = 0; i < portNUM_PROCESSORS && i < CAPTURE_BENCH_MAX_CORES; i++) {
+        TaskStatus_t st;
+        vTaskGetInfo(xTaskGetIdleTaskHandleForCPU(i), &st, pdFALSE, eRunning);
+        out[i] = st.ulRunTimeCounter;
+    }
+}
+#endif
+
+static uint32_t hist_count(const capture_hist_t* h)
+{
+    uint32_t n = 0;
+    for (int i = 0; i < CAPTURE_HIST_BUCKETS; i++) {
+        n += h->buckets[i];
+    }
+    return n;
+}
+
+static uint64_t hist_sum(const capture_hist_t* h)
+{
+    return (uint64_t)h->sum_hi << 32 | h->sum_lo;
+}
+
+esp_err_t capture_bench_run(const capture_bench_config_t* cfg, capture_bench_result_t* out)
+{
+    static bench_run_t run;   // one run at a time: the capture job task is the only caller
+    if (cfg->frame_len < CAPTURE_BENCH_MIN_FRAME_LEN || cfg->frame_len > CAPTURE_BENCH_MAX_FRAME_LEN ||
+        cfg->duration_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&run, 0, sizeof(run));
+    memset(out, 0, sizeof(*out));
+    run.cfg = *cfg;
+    if (!(run.done = xSemaphoreCreateBinary())) {
+        return ESP_ERR_NO_MEM;
+    }
+    build_frame(cfg->frame_len);
+
+    esp_err_t err = handshake_capture_synthetic_start(cfg->spiffs, &run.budget);
+    if (err != ESP_OK) {
+        vSemaphoreDelete(run.done);
+        return err;
+    }
+    capture_stats_t st;
+    handshake_capture_get_stats(&st);
+    run.large = run.cfg.frame_len > st.ring_small_size;
+    ESP_LOGI(TAG, "%u-byte frames at %s%u/s for %u ms, %u bytes of free space",
+             cfg->frame_len, cfg->rate ? "" : "up to ", (unsigned)cfg->rate,
+             (unsigned)cfg->duration_ms, (unsigned)run.budget);
+
+    const capture_hist_t* flash = &g_capture_metrics.hist[CAPTURE_HIST_FLASH_WRITE];
+    uint32_t flash_bytes = g_capture_metrics.flash_bytes;
+    uint32_t flash_errors = g_capture_metrics.flash_errors;
+    uint32_t flash_writes = hist_count(flash);
+    uint64_t flash_cycles = hist_sum(flash);
+#ifdef BENCH_CPU_LOAD
+    uint32_t idle_start[CAPTURE_BENCH_MAX_CORES] = {0};
+    idle_runtime(idle_start);
+#endif
+    int64_t start_us = esp_timer_get_time();
+
+    if (xTaskCreatePinnedToCore(generator_task, "bench_gen", GEN_TASK_STACK, &run, GEN_TASK_PRIO,
+                                NULL, GEN_TASK_CORE) != pdPASS) {
+        handshake_capture_synthetic_stop();
+        vSemaphoreDelete(run.done);
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreTake(run.done, portMAX_DELAY);
+    vSemaphoreDelete(run.done);
+
+    // Throughput and load cover the generation window; the final drain is not timed
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    out->elapsed_ms = elapsed_us / 1000;
+    out->flash_bytes = g_capture_metrics.flash_bytes - flash_bytes;
+    out->flash_errors = g_capture_metrics.flash_errors - flash_errors;
+    out->flash_writes = hist_count(flash) - flash_writes;
+    if (out->flash_writes > 0) {
+        out->flash_write_avg_us = (hist_sum(flash) - flash_cycles) /
+                                  out->flash_writes / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    }
+    for (int i = 0; i < CAPTURE_BENCH_MAX_CORES; i++) {
+        out->cpu_busy[i] = -1;
+    }
+#ifdef BENCH_CPU_LOAD
+    uint32_t idle_end[CAPTURE_BENCH_MAX_CORES] = {0};
+    idle_runtime(idle_end);
+    for (int i = 0; i < portNUM_PROCESSORS && i < CAPTURE_BENCH_MAX_CORES; i++) {
+        uint32_t idle_us = idle_end[i] - idle_start[i];
+        out->cpu_busy[i] = idle_us < elapsed_us ? 100 - (int)((int64_t)idle_us * 100 / elapsed_us) : 0;
+    }
+#endif
+
+    handshake_capture_synthetic_stop();
+    handshake_capture_get_stats(&st);
+    out->frames_offered = run.offered;
+    out->frames_written = st.frames_written;
+    out->bytes_written = st.bytes_written;
+    out->ring_slots = run.large ? st.ring_large_slots : st.ring_slots;
+    out->ring_high_water = run.large ? st.ring_large_high_water : st.ring_high_water;
+    out->ring_drops = st.ring_drops;
+    out->ring_avg_x100 = run.samples ? run.ring_sum * 100 / run.samples : 0;
+    out->budget_hit = run.budget_hit;
+
+    ESP_LOGI(TAG, "%u frames written, %u KB/s to flash (%u us per write), ring high water %u/%u, %u dropped",
+             (unsigned)out->frames_written,
+             (unsigned)(elapsed_us > 0 ? (uint64_t)out->flash_bytes * 1000 / elapsed_us : 0),
+             (unsigned)out->flash_write_avg_us, (unsigned)out->ring_high_water,
+             (unsigned)out->ring_slots, (unsigned)out->ring_drops);
+    return ESP_OK;
+}
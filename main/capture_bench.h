@@ -0,0 +1,56 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * On-target throughput benchmark of the capture path.
+ *
+ * A generator task on the Wi-Fi core feeds synthetic EAPOL-Key frames
+ * (which the classifier always keeps) through the real ring, writer task
+ * and flash output at a fixed rate, or as fast as the ring drains. The run
+ * reports sustained write throughput, flash write latency, ring occupancy
+ * and per-core CPU load, so boards and flash chips can be compared. Runs
+ * are capture jobs (capture_job_submit_bench) and never overlap a capture.
+ */
+
+#define CAPTURE_BENCH_MIN_FRAME_LEN    133      // QoS data header + LLC + shortest EAPOL-Key
+#define CAPTURE_BENCH_MAX_FRAME_LEN    2346
+#define CAPTURE_BENCH_MAX_RATE         100000   // frames/s
+#define CAPTURE_BENCH_MAX_DURATION_MS  120000
+#define CAPTURE_BENCH_MAX_CORES        2
+
+typedef struct {
+    uint32_t rate;           // frames/s offered, 0 = keep the ring full
+    uint16_t frame_len;      // bytes per frame (truncated to CONFIG_CAPTURE_SNAPLEN in the pcap)
+    uint32_t duration_ms;
+    bool     spiffs;         // write to SPIFFS even when the capture store is mounted
+} capture_bench_config_t;
+
+typedef struct {
+    uint32_t elapsed_ms;         // generation window; throughput and load cover this
+    uint32_t frames_offered;     // frames injected
+    uint32_t frames_written;     // frames appended to the pcap
+    uint32_t bytes_written;      // pcap bytes produced
+    uint32_t flash_bytes;        // bytes written to flash
+    uint32_t flash_writes;       // buffer writes issued
+    uint32_t flash_errors;
+    uint32_t flash_write_avg_us; // mean duration of one buffer write
+    uint32_t ring_slots;         // slots the frames can take: large ones only if they exceed the small size
+    uint32_t ring_high_water;    // ... most of them in use at once
+    uint32_t ring_avg_x100;      // ... mean in use, sampled every tick, times 100
+    uint32_t ring_drops;
+    int8_t   cpu_busy[CAPTURE_BENCH_MAX_CORES];   // % per core, -1 if run-time stats are off
+    bool     budget_hit;         // stopped early: the output's free space ran out
+} capture_bench_result_t;
+
+/**
+ * @brief Default run from the CONFIG_CAPTURE_BENCH_* options.
+ */
+void capture_bench_default_config(capture_bench_config_t* cfg);
+
+/**
+ * @brief Run one benchmark and delete its output. Blocks for the run.
+ *        Only call from the capture job task.
+ */
+esp_err_t capture_bench_run(const capture_bench_config_t* cfg, capture_bench_result_t* out);
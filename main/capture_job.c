@@ -0,0 +1,227 @@
+/**
+ * capture_job.c
+ *
+ * Single capture task fed by a queue of job ids. The last few jobs are kept
+ * in a small history table so clients can poll their status after the fact.
+ * Capture, survey, live and benchmark jobs share the queue and the task.
+ */
+
+#include "capture_job.h"
+#include "scan_cache.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char* TAG = "capture_job";
+
+#define JOB_HISTORY      4       // jobs remembered for /status
+#define JOB_QUEUE_DEPTH  2
+#define JOB_TASK_STACK   4096
+#define JOB_TASK_PRIO    5
+#define JOB_TASK_CORE    (CONFIG_CAPTURE_WRITER_CORE < 0 ? tskNO_AFFINITY : CONFIG_CAPTURE_WRITER_CORE)
+
+static capture_job_t s_jobs[JOB_HISTORY];
+static uint32_t s_next_id = 1;
+static uint32_t s_last_id[CAPTURE_JOB_LIVE + 1];    // per kind
+static uint32_t s_pending = 0;        // queued + running
+static QueueHandle_t s_queue = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static capture_job_t* find_job(uint32_t id)
+{
+    capture_job_t* job = &s_jobs[id % JOB_HISTORY];
+    return (id != 0 && job->id == id) ? job : NULL;
+}
+
+static void capture_task(void* arg)
+{
+    uint32_t id;
+    for (;;) {
+        if (xQueueReceive(s_queue, &id, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        capture_job_t req;
+        taskENTER_CRITICAL(&s_lock);
+        capture_job_t* job = find_job(id);
+        if (job) {
+            job->state = CAPTURE_JOB_RUNNING;
+            job->started_us = esp_timer_get_time();
+            req = *job;
+        }
+        taskEXIT_CRITICAL(&s_lock);
+        if (!job) {
+            continue;
+        }
+
+        // The job owns the radio; the passive AP table listener steps aside
+        scan_cache_listen(false);
+        esp_err_t ret;
+        switch (req.kind) {
+        case CAPTURE_JOB_SURVEY:
+            ESP_LOGI(TAG, "Job %u: %s channel survey for %u ms", (unsigned)id,
+                     handshake_capture_profile_str(req.profile), (unsigned)req.duration_ms);
+            ret = handshake_survey_capture(req.duration_ms, req.profile);
+            break;
+        case CAPTURE_JOB_BENCH:
+            ESP_LOGI(TAG, "Job %u: benchmark for %u ms", (unsigned)id, (unsigned)req.duration_ms);
+            ret = capture_bench_run(&req.bench_cfg, &req.bench);
+            break;
+        case CAPTURE_JOB_LIVE: {
+            static const uint8_t no_target[6] = {0};
+            bool whole = memcmp(req.bssid, no_target, 6) == 0;
+            ESP_LOGI(TAG, "Job %u: %s live stream on channel %u for up to %u ms", (unsigned)id,
+                     handshake_capture_profile_str(req.profile), req.channel, (unsigned)req.duration_ms);
+            ret = handshake_live_capture(whole ? NULL : req.bssid, req.channel, req.duration_ms,
+                                         req.profile, &req.sink);
+            break;
+        }
+        default:
+            ESP_LOGI(TAG, "Job %u: %s capture on channel %u for up to %u ms", (unsigned)id,
+                     handshake_capture_profile_str(req.profile), req.channel, (unsigned)req.duration_ms);
+            ret = handshake_deauth_and_capture(req.bssid, req.channel, req.duration_ms, req.profile);
+            break;
+        }
+
+        scan_cache_listen(true);
+        capture_stats_t stats;
+        handshake_capture_get_stats(&stats);
+
+        taskENTER_CRITICAL(&s_lock);
+        job = find_job(id);
+        if (job) {
+            job->result = ret;
+            job->stats = stats;
+            job->bench = req.bench;
+            job->finished_us = esp_timer_get_time();
+            job->state = (ret == ESP_OK) ? CAPTURE_JOB_DONE : CAPTURE_JOB_FAILED;
+        }
+        s_pending--;
+        taskEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "Job %u finished: %s", (unsigned)id, esp_err_to_name(ret));
+    }
+}
+
+esp_err_t capture_job_init(void)
+{
+    s_queue = xQueueCreate(JOB_QUEUE_DEPTH, sizeof(uint32_t));
+    if (!s_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreatePinnedToCore(capture_task, "capture_job", JOB_TASK_STACK, NULL, JOB_TASK_PRIO,
+                                NULL, JOB_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// Queue a job filled in from `req`; id and state are assigned here
+static esp_err_t submit(const capture_job_t* req, uint32_t* out_id)
+{
+    taskENTER_CRITICAL(&s_lock);
+    if (s_pending >= JOB_QUEUE_DEPTH) {
+        taskEXIT_CRITICAL(&s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint32_t id = s_next_id++;
+    capture_job_t* job = &s_jobs[id % JOB_HISTORY];
+    *job = *req;
+    job->id = id;
+    job->state = CAPTURE_JOB_QUEUED;
+    s_last_id[req->kind] = id;
+    s_pending++;
+    taskEXIT_CRITICAL(&s_lock);
+
+    // Cannot fail: s_pending never exceeds the queue depth
+    xQueueSend(s_queue, &id, 0);
+    *out_id = id;
+    return ESP_OK;
+}
+
+esp_err_t capture_job_submit(const uint8_t bssid[6], uint8_t channel, uint32_t duration_ms,
+                             capture_profile_t profile, uint32_t* out_id)
+{
+    capture_job_t req = { .kind = CAPTURE_JOB_CAPTURE, .channel = channel, .profile = profile,
+                          .duration_ms = duration_ms };
+    memcpy(req.bssid, bssid, 6);
+    return submit(&req, out_id);
+}
+
+esp_err_t capture_job_submit_survey(uint32_t duration_ms, capture_profile_t profile, uint32_t* out_id)
+{
+    capture_job_t req = { .kind = CAPTURE_JOB_SURVEY, .profile = profile, .duration_ms = duration_ms };
+    return submit(&req, out_id);
+}
+
+esp_err_t capture_job_submit_live(const uint8_t bssid[6], uint8_t channel, uint32_t duration_ms,
+                                  capture_profile_t profile, const pcap_writer_sink_t* sink,
+                                  uint32_t* out_id)
+{
+    capture_job_t req = { .kind = CAPTURE_JOB_LIVE, .channel = channel, .profile = profile,
+                          .duration_ms = duration_ms, .sink = *sink };
+    memcpy(req.bssid, bssid, 6);
+    return submit(&req, out_id);
+}
+
+esp_err_t capture_job_submit_bench(const capture_bench_config_t* cfg, uint32_t* out_id)
+{
+    capture_job_t req = { .kind = CAPTURE_JOB_BENCH, .duration_ms = cfg->duration_ms, .bench_cfg = *cfg };
+    return submit(&req, out_id);
+}
+
+bool capture_job_get(uint32_t id, capture_job_t* out)
+{
+    taskENTER_CRITICAL(&s_lock);
+    capture_job_t* job = find_job(id);
+    if (job) {
+        *out = *job;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    if (!job) {
+        return false;
+    }
+    if (out->state == CAPTURE_JOB_RUNNING) {
+        handshake_capture_get_stats(&out->stats);
+    }
+    return true;
+}
+
+uint32_t capture_job_latest_id(void)
+{
+    return s_next_id - 1;
+}
+
+uint32_t capture_job_latest_id_of(capture_job_kind_t kind)
+{
+    return s_last_id[kind];
+}
+
+bool capture_job_busy(void)
+{
+    return s_pending > 0;
+}
+
+const char* capture_job_state_str(capture_job_state_t state)
+{
+    switch (state) {
+    case CAPTURE_JOB_QUEUED:  return "queued";
+    case CAPTURE_JOB_RUNNING: return "running";
+    case CAPTURE_JOB_DONE:    return "done";
+    case CAPTURE_JOB_FAILED:  return "failed";
+    }
+    return "unknown";
+}
+
+const char* capture_job_kind_str(capture_job_kind_t kind)
+{
+    switch (kind) {
+    case CAPTURE_JOB_CAPTURE: return "capture";
+    case CAPTURE_JOB_SURVEY:  return "survey";
+    case CAPTURE_JOB_BENCH:   return "bench";
+    case CAPTURE_JOB_LIVE:    return "live";
+    }
+    return "unknown";
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "esp_err.h"
+#include "handshake_capture.h"
+#include "capture_bench.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Capture runs are submitted as jobs to a dedicated capture task, so HTTP
+ * handlers return immediately and poll progress instead of blocking an
+ * httpd worker for the whole capture window. Surveys, live streams and
+ * benchmark runs go through the same queue, so they never overlap a capture.
+ */
+
+typedef enum {
+    CAPTURE_JOB_CAPTURE,
+    CAPTURE_JOB_SURVEY,
+    CAPTURE_JOB_BENCH,
+    CAPTURE_JOB_LIVE,
+} capture_job_kind_t;
+
+typedef enum {
+    CAPTURE_JOB_QUEUED,
+    CAPTURE_JOB_RUNNING,
+    CAPTURE_JOB_DONE,
+    CAPTURE_JOB_FAILED,
+} capture_job_state_t;
+
+typedef struct {
+    uint32_t            id;
+    capture_job_kind_t  kind;
+    capture_job_state_t state;
+    uint8_t             bssid[6];
+    uint8_t             channel;
+    capture_profile_t   profile;       // capture and survey jobs
+    uint32_t            duration_ms;
+    int64_t             started_us;    // esp_timer time the capture began (0 while queued)
+    int64_t             finished_us;   // esp_timer time it ended (0 while not finished)
+    esp_err_t           result;
+    capture_stats_t     stats;         // live while running, final once finished
+    capture_bench_config_t bench_cfg;  // CAPTURE_JOB_BENCH only
+    capture_bench_result_t bench;      // CAPTURE_JOB_BENCH, once finished
+    pcap_writer_sink_t  sink;          // CAPTURE_JOB_LIVE output
+} capture_job_t;
+
+/**
+ * @brief Create the job queue and the capture task.
+ */
+esp_err_t capture_job_init(void);
+
+/**
+ * @brief Queue a handshake capture.
+ * @param[out] out_id Job id to pass to capture_job_get().
+ * @return ESP_ERR_INVALID_STATE if the queue is full.
+ */
+esp_err_t capture_job_submit(const uint8_t bssid[6], uint8_t channel, uint32_t duration_ms,
+                             capture_profile_t profile, uint32_t* out_id);
+
+/**
+ * @brief Queue a receive-only channel survey (see handshake_survey_capture).
+ * @return ESP_ERR_INVALID_STATE if the queue is full.
+ */
+esp_err_t capture_job_submit_survey(uint32_t duration_ms, capture_profile_t profile, uint32_t* out_id);
+
+/**
+ * @brief Queue a live capture (see handshake_live_capture) streaming to `sink`.
+ * @param bssid All zeroes to stream the whole channel.
+ * @return ESP_ERR_INVALID_STATE if the queue is full; `sink` is then untouched.
+ */
+esp_err_t capture_job_submit_live(const uint8_t bssid[6], uint8_t channel, uint32_t duration_ms,
+                                  capture_profile_t profile, const pcap_writer_sink_t* sink,
+                                  uint32_t* out_id);
+
+/**
+ * @brief Queue a benchmark run (see capture_bench.h).
+ * @return ESP_ERR_INVALID_STATE if the queue is full.
+ */
+esp_err_t capture_job_submit_bench(const capture_bench_config_t* cfg, uint32_t* out_id);
+
+/**
+ * @brief Snapshot a recent job.
+ * @return false if the id is unknown or has aged out of the job history.
+ */
+bool capture_job_get(uint32_t id, capture_job_t* out);
+
+/**
+ * @brief Id of the most recently submitted job, 0 if none yet.
+ */
+uint32_t capture_job_latest_id(void);
+
+/**
+ * @brief Id of the most recently submitted job of one kind, 0 if none yet.
+ */
+uint32_t capture_job_latest_id_of(capture_job_kind_t kind);
+
+/**
+ * @brief True while a job is queued or running.
+ */
+bool capture_job_busy(void);
+
+/**
+ * @brief Short lowercase name of a job state ("queued", "running", ...).
+ */
+const char* capture_job_state_str(capture_job_state_t state);
+
+/**
+ * @brief Short lowercase name of a job kind ("capture", "survey", "bench", "live").
+ */
+const char* capture_job_kind_str(capture_job_kind_t kind);
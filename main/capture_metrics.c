@@ -0,0 +1,160 @@
+/**
+ * capture_metrics.c
+ *
+ * Prometheus text output of the capture-path counters and histograms, plus a
+ * few gauges sampled at scrape time (ring, store, heap).
+ */
+
+#include "capture_metrics.h"
+#include "handshake_capture.h"
+#include "capture_store.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+capture_metrics_t g_capture_metrics;
+
+typedef struct {
+    capture_metrics_write_fn write;
+    void*     ctx;
+    esp_err_t err;
+    size_t    len;
+    char      buf[512];
+} prom_out_t;
+
+static void out_flush(prom_out_t* o)
+{
+    if (o->len > 0 && o->err == ESP_OK) {
+        o->err = o->write(o->ctx, o->buf, o->len);
+    }
+    o->len = 0;
+}
+
+static void out_printf(prom_out_t* o, const char* fmt, ...)
+{
+    char line[160];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        return;
+    }
+    if ((size_t)n >= sizeof(line)) {
+        n = sizeof(line) - 1;
+    }
+    if (o->len + n > sizeof(o->buf)) {
+        out_flush(o);
+    }
+    memcpy(o->buf + o->len, line, n);
+    o->len += n;
+}
+
+static void out_header(prom_out_t* o, const char* name, const char* type, const char* help)
+{
+    out_printf(o, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void out_value(prom_out_t* o, const char* name, uint64_t value)
+{
+    out_printf(o, "%s %" PRIu64 "\n", name, value);
+}
+
+static void write_hist(prom_out_t* o, const char* name, const char* help, const capture_hist_t* h)
+{
+    // Copy first so the buckets and the sum agree; retry if a carry lands meanwhile
+    capture_hist_t snap;
+    do {
+        snap = *h;
+    } while (snap.sum_hi != h->sum_hi);
+
+    const double cycle_s = 1e-6 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    out_header(o, name, "histogram", help);
+    uint32_t cumulative = 0;
+    for (int b = 0; b < CAPTURE_HIST_BUCKETS - 1; b++) {
+        cumulative += snap.buckets[b];
+        double le = (double)(1u << (CAPTURE_HIST_MIN_SHIFT + b)) * cycle_s;
+        out_printf(o, "%s_bucket{le=\"%.3g\"} %" PRIu32 "\n", name, le, cumulative);
+    }
+    cumulative += snap.buckets[CAPTURE_HIST_BUCKETS - 1];
+    out_printf(o, "%s_bucket{le=\"+Inf\"} %" PRIu32 "\n", name, cumulative);
+    uint64_t sum = ((uint64_t)snap.sum_hi << 32) | snap.sum_lo;
+    out_printf(o, "%s_sum %.6f\n", name, (double)sum * cycle_s);
+    out_printf(o, "%s_count %" PRIu32 "\n", name, cumulative);
+}
+
+esp_err_t capture_metrics_write_prometheus(capture_metrics_write_fn write, void* ctx)
+{
+    static const char* const types[CAPTURE_FRAME_TYPES] = { "mgmt", "ctrl", "data", "misc" };
+    static const char* const outcomes[CAPTURE_FRAME_OUTCOMES] = { "kept", "filtered", "ring_full" };
+    static prom_out_t o;   // handlers run one at a time
+    const capture_metrics_t* m = &g_capture_metrics;
+
+    o.write = write;
+    o.ctx = ctx;
+    o.err = ESP_OK;
+    o.len = 0;
+
+    write_hist(&o, "capture_rx_callback_seconds",
+               "Time spent in the promiscuous RX callback per frame.",
+               &m->hist[CAPTURE_HIST_RX_CALLBACK]);
+    write_hist(&o, "capture_writer_batch_seconds",
+               "Time the writer task takes to drain the capture ring once.",
+               &m->hist[CAPTURE_HIST_WRITER_BATCH]);
+    write_hist(&o, "capture_flash_write_seconds",
+               "Time to write one pcap buffer to SPIFFS or the capture store.",
+               &m->hist[CAPTURE_HIST_FLASH_WRITE]);
+
+    out_header(&o, "capture_frames_total", "counter", "Frames delivered to the RX callback, by type and outcome.");
+    for (int t = 0; t < CAPTURE_FRAME_TYPES; t++) {
+        for (int r = 0; r < CAPTURE_FRAME_OUTCOMES; r++) {
+            out_printf(&o, "capture_frames_total{type=\"%s\",outcome=\"%s\"} %" PRIu32 "\n",
+                       types[t], outcomes[r], m->frames[t][r]);
+        }
+    }
+    out_header(&o, "capture_flash_bytes_total", "counter", "Pcap bytes written to flash.");
+    out_value(&o, "capture_flash_bytes_total", m->flash_bytes);
+    out_header(&o, "capture_flash_errors_total", "counter", "Failed pcap buffer writes.");
+    out_value(&o, "capture_flash_errors_total", m->flash_errors);
+    out_header(&o, "capture_dedup_dropped_total", "counter", "Repeated frames dropped before writing.");
+    out_value(&o, "capture_dedup_dropped_total", m->dedup_dropped);
+    out_header(&o, "capture_runs_total", "counter", "Capture runs started.");
+    out_value(&o, "capture_runs_total", m->captures);
+
+    capture_stats_t st;
+    handshake_capture_get_stats(&st);
+    out_header(&o, "capture_ring_slots", "gauge", "Capture ring capacity.");
+    out_value(&o, "capture_ring_slots", st.ring_slots);
+    out_header(&o, "capture_ring_high_water", "gauge", "Most ring slots in use at once during the current or last capture.");
+    out_value(&o, "capture_ring_high_water", st.ring_high_water);
+    out_header(&o, "capture_ring_large_slots", "gauge", "Ring slots sized for frames up to the snaplen.");
+    out_value(&o, "capture_ring_large_slots", st.ring_large_slots);
+    out_header(&o, "capture_ring_large_high_water", "gauge", "Most large ring slots in use at once during the current or last capture.");
+    out_value(&o, "capture_ring_large_high_water", st.ring_large_high_water);
+    out_header(&o, "capture_ring_bytes", "gauge", "Memory held by the capture ring.");
+    out_value(&o, "capture_ring_bytes", st.ring_bytes);
+
+    capture_store_t* store = handshake_capture_store();
+    if (store) {
+        size_t used, total;
+        capture_store_usage(store, &used, &total);
+        out_header(&o, "capture_store_used_bytes", "gauge", "Capture store bytes held by live records.");
+        out_value(&o, "capture_store_used_bytes", used);
+        out_header(&o, "capture_store_size_bytes", "gauge", "Capture store log size.");
+        out_value(&o, "capture_store_size_bytes", total);
+    }
+
+    out_header(&o, "heap_free_bytes", "gauge", "Free heap.");
+    out_value(&o, "heap_free_bytes", esp_get_free_heap_size());
+    out_header(&o, "heap_min_free_bytes", "gauge", "Lowest free heap since boot.");
+    out_value(&o, "heap_min_free_bytes", esp_get_minimum_free_heap_size());
+    out_header(&o, "uptime_seconds", "counter", "Time since boot.");
+    out_printf(&o, "uptime_seconds %.3f\n", esp_timer_get_time() / 1e6);
+
+    out_flush(&o);
+    return o.err;
+}
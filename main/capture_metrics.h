@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_cpu.h"
+
+/**
+ * Cumulative capture-path instrumentation, published at /metrics.
+ *
+ * Every counter here only grows for the lifetime of the firmware (unlike
+ * capture_stats_t, which restarts with each capture), and each one has a
+ * single writer task, so updates are plain stores with no locking. Latencies
+ * are measured in CPU cycles and kept as log2 histograms.
+ */
+
+#define CAPTURE_HIST_MIN_SHIFT  6    // first bucket: < 2^6 cycles
+#define CAPTURE_HIST_BUCKETS    24   // last bucket (from 2^28 cycles) is the overflow
+
+typedef enum {
+    CAPTURE_HIST_RX_CALLBACK,    // promiscuous RX callback, per frame (Wi-Fi task)
+    CAPTURE_HIST_WRITER_BATCH,   // writer task draining the ring once (writer task)
+    CAPTURE_HIST_FLASH_WRITE,    // one pcap buffer written to SPIFFS or the store
+    CAPTURE_HIST_COUNT
+} capture_hist_id_t;
+
+// What happened to a frame delivered to the RX callback
+typedef enum {
+    CAPTURE_FRAME_KEPT,          // queued for the pcap
+    CAPTURE_FRAME_FILTERED,      // rejected by type or by the classifier
+    CAPTURE_FRAME_RING_FULL,     // kept by the classifier, but the ring was full
+    CAPTURE_FRAME_OUTCOMES
+} capture_frame_outcome_t;
+
+#define CAPTURE_FRAME_TYPES  4   // wifi_promiscuous_pkt_type_t: MGMT, CTRL, DATA, MISC
+
+typedef struct {
+    uint32_t buckets[CAPTURE_HIST_BUCKETS];   // their sum is the sample count
+    uint32_t sum_lo;             // total cycles, split so a reader can detect a carry
+    uint32_t sum_hi;
+} capture_hist_t;
+
+typedef struct {
+    capture_hist_t hist[CAPTURE_HIST_COUNT];
+    uint32_t frames[CAPTURE_FRAME_TYPES][CAPTURE_FRAME_OUTCOMES];
+    uint32_t flash_bytes;        // pcap bytes written to flash
+    uint32_t flash_errors;       // failed pcap buffer writes
+    uint32_t dedup_dropped;      // repeated frames the writer skipped (writer task)
+    uint32_t captures;           // capture runs started
+} capture_metrics_t;
+
+extern capture_metrics_t g_capture_metrics;
+
+static inline uint32_t capture_cycles(void)
+{
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
+
+/**
+ * @brief Add one latency sample. Only the histogram's own task may call this.
+ */
+static inline void capture_hist_add(capture_hist_id_t id, uint32_t cycles)
+{
+    capture_hist_t* h = &g_capture_metrics.hist[id];
+    int bits = cycles ? 32 - __builtin_clz(cycles) : 0;
+    int b = bits > CAPTURE_HIST_MIN_SHIFT ? bits - CAPTURE_HIST_MIN_SHIFT : 0;
+    h->buckets[b < CAPTURE_HIST_BUCKETS ? b : CAPTURE_HIST_BUCKETS - 1]++;
+    uint32_t lo = h->sum_lo + cycles;
+    if (lo < cycles) {
+        h->sum_hi++;
+    }
+    h->sum_lo = lo;
+}
+
+/**
+ * @brief Count a frame seen by the RX callback. Wi-Fi task only.
+ */
+static inline void capture_metrics_frame(unsigned type, capture_frame_outcome_t outcome)
+{
+    g_capture_metrics.frames[type & (CAPTURE_FRAME_TYPES - 1)][outcome]++;
+}
+
+typedef esp_err_t (*capture_metrics_write_fn)(void* ctx, const char* text, size_t len);
+
+/**
+ * @brief Write all metrics in Prometheus text exposition format (version 0.0.4).
+ */
+esp_err_t capture_metrics_write_prometheus(capture_metrics_write_fn write, void* ctx);
@@ -0,0 +1,164 @@
+/**
+ * capture_ring.c
+ *
+ * Lock-free SPSC frame ring between the promiscuous RX callback and the
+ * capture writer task. Indices run freely and are masked on access; each
+ * slab keeps its own indices, advanced at commit and release.
+ */
+
+#include "capture_ring.h"
+#include "esp_heap_caps.h"
+#include <stdlib.h>
+
+static uint32_t pow2_at_least(uint32_t n)
+{
+    uint32_t size = 1;
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+static uint8_t* slab_alloc(size_t bytes, bool psram, bool* in_psram)
+{
+    uint8_t* buf = psram ? heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM) : NULL;
+    *in_psram = buf != NULL;
+    if (!buf) {
+        buf = heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    }
+    return buf;
+}
+
+esp_err_t capture_ring_init(capture_ring_t* ring, uint32_t small_slots, uint32_t small_size,
+                            uint32_t large_slots, uint32_t large_size, bool psram)
+{
+    const uint32_t count[CAPTURE_RING_CLASSES] = {
+        small_slots ? pow2_at_least(small_slots) : 0,
+        large_slots ? pow2_at_least(large_slots) : 0,
+    };
+    const uint32_t size[CAPTURE_RING_CLASSES] = { small_size, large_size };
+    uint32_t descs = pow2_at_least(count[0] + count[1]);
+
+    ring->slots = calloc(descs, sizeof(capture_slot_t));
+    if (!ring->slots) {
+        return ESP_ERR_NO_MEM;
+    }
+    ring->mask = descs - 1;
+    ring->bytes = descs * sizeof(capture_slot_t);
+    ring->psram = psram;
+    for (int c = 0; c < CAPTURE_RING_CLASSES; c++) {
+        capture_slab_t* slab = &ring->slab[c];
+        slab->buf = NULL;
+        slab->size = size[c];
+        slab->mask = count[c] ? count[c] - 1 : 0;
+        if (!count[c]) {
+            continue;
+        }
+        bool in_psram;
+        slab->buf = slab_alloc((size_t)count[c] * size[c], psram, &in_psram);
+        if (!slab->buf) {
+            for (int k = 0; k < c; k++) {
+                heap_caps_free(ring->slab[k].buf);
+                ring->slab[k].buf = NULL;
+            }
+            free(ring->slots);
+            ring->slots = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+        ring->psram = ring->psram && in_psram;
+        ring->bytes += (size_t)count[c] * size[c];
+    }
+    capture_ring_reset(ring);
+    return ESP_OK;
+}
+
+void capture_ring_reset(capture_ring_t* ring)
+{
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    atomic_store(&ring->dropped, 0);
+    atomic_store(&ring->high_water, 0);
+    for (int c = 0; c < CAPTURE_RING_CLASSES; c++) {
+        atomic_store(&ring->slab[c].head, 0);
+        atomic_store(&ring->slab[c].tail, 0);
+        atomic_store(&ring->slab[c].high_water, 0);
+    }
+}
+
+static bool slab_has_room(capture_slab_t* slab)
+{
+    if (!slab->buf) {
+        return false;
+    }
+    uint32_t head = atomic_load_explicit(&slab->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&slab->tail, memory_order_acquire);
+    return head - tail <= slab->mask;
+}
+
+capture_slot_t* capture_ring_reserve(capture_ring_t* ring, uint32_t len)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    int cls = -1;
+    if (head - tail <= ring->mask) {
+        capture_slab_t* small = &ring->slab[CAPTURE_RING_SMALL];
+        if (len <= small->size && slab_has_room(small)) {
+            cls = CAPTURE_RING_SMALL;
+        } else if (slab_has_room(&ring->slab[CAPTURE_RING_LARGE])) {
+            cls = CAPTURE_RING_LARGE;
+        }
+    }
+    if (cls < 0) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    capture_slab_t* slab = &ring->slab[cls];
+    uint32_t index = atomic_load_explicit(&slab->head, memory_order_relaxed) & slab->mask;
+    capture_slot_t* slot = &ring->slots[head & ring->mask];
+    slot->cls = cls;
+    slot->data = slab->buf + index * slab->size;
+    slot->len = len < slab->size ? len : slab->size;   // snaplen applies here
+    return slot;
+}
+
+static void note_high_water(atomic_uint* high_water, uint32_t used)
+{
+    if (used > atomic_load_explicit(high_water, memory_order_relaxed)) {
+        atomic_store_explicit(high_water, used, memory_order_relaxed);
+    }
+}
+
+uint32_t capture_ring_commit(capture_ring_t* ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    capture_slab_t* slab = &ring->slab[ring->slots[head & ring->mask].cls];
+    uint32_t slab_head = atomic_load_explicit(&slab->head, memory_order_relaxed) + 1;
+    atomic_store_explicit(&slab->head, slab_head, memory_order_release);
+    note_high_water(&slab->high_water, slab_head - atomic_load_explicit(&slab->tail, memory_order_relaxed));
+
+    head++;
+    atomic_store_explicit(&ring->head, head, memory_order_release);
+    uint32_t used = head - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    note_high_water(&ring->high_water, used);
+    return used;
+}
+
+const capture_slot_t* capture_ring_peek(capture_ring_t* ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail == head) {
+        return NULL;
+    }
+    return &ring->slots[tail & ring->mask];
+}
+
+void capture_ring_release(capture_ring_t* ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    capture_slab_t* slab = &ring->slab[ring->slots[tail & ring->mask].cls];
+    atomic_store_explicit(&slab->tail, atomic_load_explicit(&slab->tail, memory_order_relaxed) + 1,
+                          memory_order_release);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+#include "pcap_writer.h"
+
+/**
+ * Single-producer / single-consumer ring of frame descriptors over two slabs of
+ * preallocated, fixed-size data slots.
+ *
+ * The producer (Wi-Fi RX callback) reserves a slot for a frame length, copies the
+ * frame into it and commits it; the consumer (capture writer task) peeks committed
+ * slots in order and releases them once written. Frames up to the small slot size
+ * take a small slot (a large one if the small slab is full); longer frames take a
+ * large slot of CONFIG_CAPTURE_SNAPLEN bytes and are truncated to it on copy. Both
+ * slabs are filled and drained in ring order, so each is a FIFO of its own.
+ * head is only written by the producer and tail only by the consumer, so neither
+ * side ever takes a lock or blocks, and nothing is allocated after init.
+ */
+
+#define CAPTURE_RING_SMALL  0
+#define CAPTURE_RING_LARGE  1
+#define CAPTURE_RING_CLASSES 2
+
+typedef struct {
+    struct timeval ts;        // RX timestamp
+    uint16_t len;             // bytes stored at data (≤ the slot size)
+    uint16_t orig_len;        // frame length on air, without FCS
+    uint8_t  cls;             // CAPTURE_RING_SMALL / _LARGE
+    pcap_radio_info_t radio;  // rx_ctrl summary for the radiotap header
+    uint8_t* data;            // the slab slot holding the frame
+} capture_slot_t;
+
+typedef struct {
+    uint8_t*     buf;
+    uint32_t     size;         // bytes per slot
+    uint32_t     mask;         // slot count - 1 (0 slots: buf is NULL)
+    atomic_uint  head;         // producer-owned
+    atomic_uint  tail;         // consumer-owned
+    atomic_uint  high_water;   // max slots of this class in use at once
+} capture_slab_t;
+
+typedef struct {
+    capture_slot_t*  slots;
+    uint32_t         mask;         // descriptor count - 1 (a power of two)
+    atomic_uint      head;         // next slot to fill, producer-owned
+    atomic_uint      tail;         // next slot to drain, consumer-owned
+    atomic_uint      dropped;      // frames rejected because no slot was free
+    atomic_uint      high_water;   // max slots in use at once
+    capture_slab_t   slab[CAPTURE_RING_CLASSES];
+    size_t           bytes;        // slab memory, descriptors included
+    bool             psram;        // slabs live in PSRAM
+} capture_ring_t;
+
+/**
+ * @brief Allocate the descriptors and both slabs. Slot counts are rounded up to a power
+ *        of two. Slabs come from PSRAM when `psram` is set and it has room, otherwise
+ *        from internal RAM.
+ */
+esp_err_t capture_ring_init(capture_ring_t* ring, uint32_t small_slots, uint32_t small_size,
+                            uint32_t large_slots, uint32_t large_size, bool psram);
+
+/**
+ * @brief Empty the ring and clear its counters. Only call while neither side is active.
+ */
+void capture_ring_reset(capture_ring_t* ring);
+
+/**
+ * @brief Producer: get a slot for a frame of `len` bytes, or NULL (and count a drop)
+ *        if none is free. slot->len and slot->cls are set: the bytes to copy, at
+ *        most the slot size.
+ */
+capture_slot_t* capture_ring_reserve(capture_ring_t* ring, uint32_t len);
+
+/**
+ * @brief Producer: publish the slot returned by the last capture_ring_reserve().
+ * @return Number of slots in use after the commit.
+ */
+uint32_t capture_ring_commit(capture_ring_t* ring);
+
+/**
+ * @brief Consumer: oldest committed slot, or NULL if the ring is empty.
+ */
+const capture_slot_t* capture_ring_peek(capture_ring_t* ring);
+
+/**
+ * @brief Consumer: hand the slot returned by capture_ring_peek() back to the producer.
+ */
+void capture_ring_release(capture_ring_t* ring);
+
+/**
+ * @brief Slots in use right now. Either side may call this; the answer can be stale by the time it returns.
+ */
+static inline uint32_t capture_ring_used(capture_ring_t* ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) -
+           atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+/**
+ * @brief Total number of data slots, both classes.
+ */
+static inline uint32_t capture_ring_capacity(const capture_ring_t* ring)
+{
+    uint32_t n = 0;
+    for (int c = 0; c < CAPTURE_RING_CLASSES; c++) {
+        n += ring->slab[c].buf ? ring->slab[c].mask + 1 : 0;
+    }
+    return n;
+}
+
+/**
+ * @brief Slots of one class in use right now; stale like capture_ring_used().
+ */
+static inline uint32_t capture_ring_class_used(capture_ring_t* ring, int cls)
+{
+    return atomic_load_explicit(&ring->slab[cls].head, memory_order_relaxed) -
+           atomic_load_explicit(&ring->slab[cls].tail, memory_order_relaxed);
+}
+
+/**
+ * @brief Data slots of one class.
+ */
+static inline uint32_t capture_ring_class_slots(const capture_ring_t* ring, int cls)
+{
+    return ring->slab[cls].buf ? ring->slab[cls].mask + 1 : 0;
+}
@@ -1,62 +1,1084 @@
+/**
+ * handshake_capture.c
+ *
+ * Promiscuous capture pipeline:
+ *  - promisc_cb (Wi-Fi task) classifies each frame and copies the keepers
+ *    (EAPOL-Key, first beacon per BSSID) into a preallocated SPSC ring
+ *  - a writer task drains the ring in batches into the PCAP file and feeds
+ *    EAPOL-Key frames to the handshake tracker, which ends the capture early
+ *    through an event group once the target's handshake is complete; the
+ *    same messages feed the hashcat 22000 converter, whose lines go to a
+ *    small side file so a crackable result can be fetched without the pcap
+ *
+ * With CONFIG_CAPTURE_DEDUP the writer drops retransmissions and other
+ * repeated copies of a frame before they reach the tracker or the pcap.
+ *
+ * With CONFIG_CAPTURE_RADIOTAP the callback also keeps RSSI, noise floor,
+ * channel and rate from rx_ctrl, and the writer turns them into a radiotap
+ * header in front of each frame.
+ *
+ * With CONFIG_CAPTURE_RAM_ARENA_SIZE the PCAP writer records into a RAM
+ * arena and SPIFFS is written once, when the capture ends; the image stays
+ * in RAM afterwards so /download can serve it without reading flash.
+ *
+ * With a capture store the pcap bytes go to a raw flash partition through a
+ * pcap_writer sink instead of a SPIFFS file.
+ *
+ * A survey runs the same pipeline with no target while the capture task hops
+ * channels; the dwell on each channel follows its recent activity.
+ *
+ * For benchmarks the same pipeline can be fed synthetic frames from a task
+ * (handshake_capture_inject) with the radio left alone.
+ *
+ * The RX callback never touches SPIFFS, so slow flash writes cannot stall the
+ * Wi-Fi stack; when the writer falls behind, frames are dropped and counted.
+ */
+
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 #include "esp_wifi.h"
+#include "esp_mac.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_vfs_spiffs.h"
 #include "pcap_writer.h"
+#include "frame_filter.h"
+#include "eapol_tracker.h"
+#include "hc22000.h"
+#include "frame_dedup.h"
+#include "ieee80211.h"
+#include "capture_ring.h"
+#include "capture_metrics.h"
+#include "scan_cache.h"
+#include "handshake_capture.h"
 
 static const char *TAG = "handshake_capture";
 
-static wifi_promiscuous_cb_t orig_cb = NULL;
-static pcap_writer_t *pcap_writer = NULL;
+#define FCS_LEN         4     // rx_ctrl.sig_len includes the 802.11 FCS
+#define WRITER_IDLE_MS  100   // writer wakes at least this often to drain partial batches
+#define RING_SMALL_SIZE ((CONFIG_CAPTURE_RING_SMALL_SIZE < CONFIG_CAPTURE_SNAPLEN) ? \
+                         CONFIG_CAPTURE_RING_SMALL_SIZE : CONFIG_CAPTURE_SNAPLEN)
+#ifdef CONFIG_CAPTURE_RING_PSRAM
+#define RING_PSRAM      true
+#else
+#define RING_PSRAM      false
+#endif
+#define WRITER_CORE     (CONFIG_CAPTURE_WRITER_CORE < 0 ? tskNO_AFFINITY : CONFIG_CAPTURE_WRITER_CORE)
+
+#define CAPTURE_EVT_PAIR  BIT0  // target has a crackable pair (M1+M2 or M2+M3)
+#define CAPTURE_EVT_FULL  BIT1  // target has all four messages
+#define CAPTURE_EVT_LOST  BIT2  // live capture: the sink refused data (client gone)
+
+#ifdef CONFIG_CAPTURE_WAIT_FULL_HANDSHAKE
+#define CAPTURE_EVT_DONE  CAPTURE_EVT_FULL
+#else
+#define CAPTURE_EVT_DONE  CAPTURE_EVT_PAIR
+#endif
+
+typedef struct {
+    const char*     name;
+    uint32_t        filter_mask;   // wifi_promiscuous_filter_t::filter_mask
+    uint32_t        ctrl_mask;     // control subtypes passed up, 0 = none
+    frame_profile_t classify;
+} capture_profile_desc_t;
+
+// Data frames are only asked for where EAPOL or full traffic is wanted
+static const capture_profile_desc_t s_profiles[CAPTURE_PROFILE_COUNT] = {
+    [CAPTURE_PROFILE_HANDSHAKE] = { "handshake", WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_DATA,
+                                    0, FRAME_PROFILE_HANDSHAKE },
+    [CAPTURE_PROFILE_MGMT]      = { "mgmt", WIFI_PROMIS_FILTER_MASK_MGMT, 0, FRAME_PROFILE_MGMT },
+    [CAPTURE_PROFILE_FULL]      = { "full", WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_DATA |
+                                    WIFI_PROMIS_FILTER_MASK_CTRL, WIFI_PROMIS_CTRL_FILTER_MASK_ALL,
+                                    FRAME_PROFILE_FULL },
+};
+
+static frame_filter_t s_filter;
+static capture_ring_t s_ring;
+static pcap_writer_t *s_pcap = NULL;
+static TaskHandle_t s_writer_task = NULL;
+static SemaphoreHandle_t s_writer_done = NULL;
+static atomic_bool s_writer_stop;
+static EventGroupHandle_t s_events = NULL;
+
+// Writer-task state
+static eapol_tracker_t s_tracker;
+static hc22000_t s_hc;
+static FILE *s_hc_file = NULL;
+static uint8_t s_target[6];
+#ifdef CONFIG_CAPTURE_DEDUP
+static frame_dedup_entry_t s_dedup_entries[CONFIG_CAPTURE_DEDUP_SLOTS];
+static frame_dedup_t s_dedup;
+#endif
+
+static capture_store_t *s_store = NULL;
+static uint32_t s_record = 0;            // store record being written, then the last one
+static capture_entry_t s_file_entry;     // HANDSHAKE_PCAP_PATH metadata (no store), this boot only
+static atomic_uint s_target_msgs;
+static pcap_writer_sink_t s_live;        // live capture output; write == NULL otherwise
+
+#if CONFIG_CAPTURE_RAM_ARENA_SIZE > 0
+static uint8_t *s_arena = NULL;
+static size_t s_arena_image = 0;         // bytes of a complete pcap image in s_arena, 0 if none
+static uint32_t s_arena_id = 0;          // capture the image belongs to
+static uint32_t s_arena_readers = 0;     // downloads sending the image right now
+static SemaphoreHandle_t s_arena_lock = NULL;   // guards the three above, never held across I/O
+#endif
+
+static atomic_uint s_frames_seen;
+static atomic_uint s_frames_written;
+static atomic_uint s_frames_duplicate;
+static atomic_uint s_write_errors;
+static atomic_uint s_bytes_written;
+
+#ifdef CONFIG_CAPTURE_RADIOTAP
+// rx_ctrl.rate (wifi_phy_rate_t) → legacy rate in 500 kb/s units
+static const uint8_t s_phy_rate_500k[16] = {
+    2, 4, 11, 22, 0, 4, 11, 22,          // 1M, 2M, 5.5M, 11M long; -, 2M, 5.5M, 11M short
+    96, 48, 24, 12, 108, 72, 36, 18,     // 48M, 24M, 12M, 6M, 54M, 36M, 18M, 9M
+};
+
+static void fill_radio(pcap_radio_info_t *radio, const wifi_pkt_rx_ctrl_t *rx) {
+    radio->rssi = rx->rssi;
+    radio->noise = rx->noise_floor;
+    radio->freq_mhz = (rx->channel == 14) ? 2484 : (rx->channel ? 2407 + 5 * rx->channel : 0);
+    if (rx->sig_mode == 0) {
+        radio->rate = s_phy_rate_500k[rx->rate & 0xf];
+        radio->mcs = PCAP_RADIO_NO_MCS;
+    } else {
+        radio->rate = 0;
+        radio->mcs = rx->mcs;
+    }
+    radio->bw40 = rx->cwb;
+    radio->sgi = rx->sgi;
+}
+#endif
+
+// Classify one frame and copy it into the ring if it is kept
+static capture_frame_outcome_t queue_frame(const uint8_t *frame, uint32_t len, const wifi_pkt_rx_ctrl_t *rx) {
+    // Decide before copying anything: most traffic is discarded here
+    if (frame_filter_classify(&s_filter, frame, len) == FRAME_DROP) {
+        return CAPTURE_FRAME_FILTERED;
+    }
+
+    // The slot's size class is picked from len; snaplen truncation happens on this copy
+    capture_slot_t *slot = capture_ring_reserve(&s_ring, len);
+    if (!slot) {
+        return CAPTURE_FRAME_RING_FULL;
+    }
+    gettimeofday(&slot->ts, NULL);
+    slot->orig_len = len;
+    memcpy(slot->data, frame, slot->len);
+#ifdef CONFIG_CAPTURE_RADIOTAP
+    fill_radio(&slot->radio, rx);
+#endif
+
+    // Wake the writer once per batch; it also polls every WRITER_IDLE_MS
+    if (capture_ring_commit(&s_ring) == CONFIG_CAPTURE_WRITER_BATCH) {
+        xTaskNotifyGive(s_writer_task);
+    }
+    return CAPTURE_FRAME_KEPT;
+}
+
+static capture_frame_outcome_t rx_frame(const wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type) {
+    // Control frames only arrive when the profile's ctrl mask lets them through
+    if (type != WIFI_PKT_MGMT && type != WIFI_PKT_DATA && type != WIFI_PKT_CTRL) {
+        return CAPTURE_FRAME_FILTERED;
+    }
+    uint32_t len = pkt->rx_ctrl.sig_len;
+    len = (len > FCS_LEN) ? len - FCS_LEN : 0;
+    // Keep the AP/client table current while the capture owns the radio
+    scan_cache_observe(pkt->payload, len, pkt->rx_ctrl.rssi, pkt->rx_ctrl.channel);
+    return queue_frame(pkt->payload, len, &pkt->rx_ctrl);
+}
 
 static void promisc_cb(void *buf, wifi_promiscuous_pkt_type_t type) {
-    const wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
+    uint32_t start = capture_cycles();
+    atomic_fetch_add_explicit(&s_frames_seen, 1, memory_order_relaxed);
+    capture_metrics_frame(type, rx_frame((const wifi_promiscuous_pkt_t *)buf, type));
+    capture_hist_add(CAPTURE_HIST_RX_CALLBACK, capture_cycles() - start);
+}
 
-    if (type == WIFI_PKT_MGMT) {
-        // Capture handshake packets logic
-        pcap_writer_write(pcap_writer, pkt->payload, pkt->rx_ctrl.sig_len);
+static void hc_emit(void *ctx, const char *line, size_t len) {
+    if (s_hc_file) {
+        // Rare and tiny: push each line out so a reset loses nothing
+        fwrite(line, 1, len, s_hc_file);
+        fflush(s_hc_file);
     }
+}
 
-    if (orig_cb) {
-        orig_cb(buf, type);
+static void track_handshake(const capture_slot_t *slot) {
+    if (IEEE80211_FC0_TYPE(slot->data[0]) == IEEE80211_TYPE_MGMT) {
+        hc22000_add_beacon(&s_hc, slot->data, slot->len);
+        return;
+    }
+    eapol_key_t key;
+    if (!eapol_parse(slot->data, slot->len, &key)) {
+        return;
+    }
+    hc22000_add_key(&s_hc, &key);
+    const eapol_session_t *sess = eapol_tracker_add(&s_tracker, &key);
+    ESP_LOGD(TAG, "EAPOL M%u " MACSTR " -> " MACSTR, key.msg, MAC2STR(key.ap), MAC2STR(key.sta));
+    if (memcmp(sess->ap, s_target, 6) != 0) {
+        return;
+    }
+
+    atomic_fetch_or(&s_target_msgs, sess->msgs);
+    EventBits_t bits = 0;
+    if (eapol_session_has_pair(sess)) {
+        bits |= CAPTURE_EVT_PAIR;
+    }
+    if ((sess->msgs & EAPOL_MSGS_ALL) == EAPOL_MSGS_ALL) {
+        bits |= CAPTURE_EVT_FULL;
+    }
+    if (bits) {
+        xEventGroupSetBits(s_events, bits);
+    }
+}
+
+// Retries carry the same payload: write and track the first copy only
+static bool is_duplicate(const capture_slot_t *slot) {
+#ifdef CONFIG_CAPTURE_DEDUP
+    uint32_t ms = (uint32_t)slot->ts.tv_sec * 1000 + slot->ts.tv_usec / 1000;
+    if (frame_dedup_seen(&s_dedup, slot->data, slot->len, slot->orig_len, ms)) {
+        atomic_fetch_add_explicit(&s_frames_duplicate, 1, memory_order_relaxed);
+        g_capture_metrics.dedup_dropped++;
+        return true;
+    }
+#endif
+    return false;
+}
+
+static void drain_ring(void) {
+    uint32_t start = capture_cycles();
+    uint32_t drained = 0;
+    const capture_slot_t *slot;
+    while ((slot = capture_ring_peek(&s_ring)) != NULL) {
+        drained++;
+        if (is_duplicate(slot)) {
+            capture_ring_release(&s_ring);
+            continue;
+        }
+        track_handshake(slot);
+        if (pcap_writer_write_frame(s_pcap, &slot->ts, &slot->radio, slot->data,
+                                    slot->len, slot->orig_len)) {
+            atomic_fetch_add_explicit(&s_frames_written, 1, memory_order_relaxed);
+        } else {
+            atomic_fetch_add_explicit(&s_write_errors, 1, memory_order_relaxed);
+        }
+        capture_ring_release(&s_ring);
+    }
+    pcap_writer_poll(s_pcap);
+
+    pcap_writer_stats_t st;
+    pcap_writer_get_stats(s_pcap, &st);
+    atomic_store_explicit(&s_bytes_written, st.bytes + st.pending, memory_order_relaxed);
+    if (drained > 0) {   // idle wake-ups would swamp the histogram
+        capture_hist_add(CAPTURE_HIST_WRITER_BATCH, capture_cycles() - start);
     }
 }
 
-esp_err_t handshake_deauth_and_capture(void) {
-    esp_err_t err;
+static void writer_task(void *arg) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WRITER_IDLE_MS));
+        // Sample the stop flag before draining so the last batch is never left behind
+        bool stop = atomic_load(&s_writer_stop);
+        drain_ring();
+        if (stop) {
+            break;
+        }
+    }
+    xSemaphoreGive(s_writer_done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t writer_start(void) {
+    if (!s_ring.slots) {
+        esp_err_t err = capture_ring_init(&s_ring, CONFIG_CAPTURE_RING_SLOTS, RING_SMALL_SIZE,
+                                          CONFIG_CAPTURE_RING_LARGE_SLOTS, CONFIG_CAPTURE_SNAPLEN,
+                                          RING_PSRAM);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to allocate capture ring (%d x %d + %d x %d bytes)",
+                     CONFIG_CAPTURE_RING_SLOTS, RING_SMALL_SIZE,
+                     CONFIG_CAPTURE_RING_LARGE_SLOTS, CONFIG_CAPTURE_SNAPLEN);
+            return err;
+        }
+        ESP_LOGI(TAG, "Capture ring: %u small (%u B) + %u large (%u B) slots, %u bytes in %s",
+                 (unsigned)capture_ring_class_slots(&s_ring, CAPTURE_RING_SMALL), (unsigned)RING_SMALL_SIZE,
+                 (unsigned)capture_ring_class_slots(&s_ring, CAPTURE_RING_LARGE), (unsigned)CONFIG_CAPTURE_SNAPLEN,
+                 (unsigned)s_ring.bytes, s_ring.psram ? "PSRAM" : "internal RAM");
+    }
+    if (!s_writer_done) {
+        s_writer_done = xSemaphoreCreateBinary();
+        s_events = xEventGroupCreate();
+        if (!s_writer_done || !s_events) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    capture_ring_reset(&s_ring);
+    frame_filter_reset(&s_filter);
+    eapol_tracker_reset(&s_tracker);
+#ifdef CONFIG_CAPTURE_DEDUP
+    if (!s_dedup.entries) {
+        frame_dedup_init(&s_dedup, s_dedup_entries, CONFIG_CAPTURE_DEDUP_SLOTS, CONFIG_CAPTURE_DEDUP_WINDOW_MS);
+    }
+    frame_dedup_reset(&s_dedup);
+#endif
+    xEventGroupClearBits(s_events, CAPTURE_EVT_PAIR | CAPTURE_EVT_FULL | CAPTURE_EVT_LOST);
+    atomic_store(&s_target_msgs, 0);
+    atomic_store(&s_frames_seen, 0);
+    atomic_store(&s_frames_written, 0);
+    atomic_store(&s_frames_duplicate, 0);
+    atomic_store(&s_write_errors, 0);
+    atomic_store(&s_bytes_written, 0);
+    atomic_store(&s_writer_stop, false);
+
+    if (xTaskCreatePinnedToCore(writer_task, "cap_writer", CONFIG_CAPTURE_WRITER_STACK_SIZE, NULL,
+                                CONFIG_CAPTURE_WRITER_PRIORITY, &s_writer_task, WRITER_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void writer_stop(void) {
+    atomic_store(&s_writer_stop, true);
+    xTaskNotifyGive(s_writer_task);
+    xSemaphoreTake(s_writer_done, portMAX_DELAY);
+    s_writer_task = NULL;
+
+    ESP_LOGI(TAG, "Capture done: %u seen, %u EAPOL, %u beacons, %u other, %u written, %u hashes, %u dropped (ring high water %u/%u)",
+             atomic_load(&s_frames_seen), (unsigned)s_filter.stats.eapol, (unsigned)s_filter.stats.beacons,
+             (unsigned)s_filter.stats.other, atomic_load(&s_frames_written), (unsigned)s_hc.lines,
+             atomic_load(&s_ring.dropped), atomic_load(&s_ring.high_water),
+             capture_ring_capacity(&s_ring));
+}
+
+#if CONFIG_CAPTURE_RAM_ARENA_SIZE > 0
+/**
+ * @brief Get the arena ready for a new capture, allocating it on first use.
+ * @return NULL if it cannot be allocated; the capture then writes to flash directly.
+ */
+static uint8_t *arena_claim(void) {
+    if (!s_arena_lock && !(s_arena_lock = xSemaphoreCreateMutex())) {
+        return NULL;
+    }
+    if (!s_arena) {
+#if CONFIG_SPIRAM
+        s_arena = heap_caps_malloc(CONFIG_CAPTURE_RAM_ARENA_SIZE, MALLOC_CAP_SPIRAM);
+#endif
+        if (!s_arena) {
+            s_arena = heap_caps_malloc(CONFIG_CAPTURE_RAM_ARENA_SIZE, MALLOC_CAP_8BIT);
+        }
+        if (!s_arena) {
+            ESP_LOGW(TAG, "No memory for %d-byte capture arena, writing to flash directly",
+                     CONFIG_CAPTURE_RAM_ARENA_SIZE);
+            return NULL;
+        }
+    }
+    // A download still sending the previous image keeps it; that image is already
+    // on flash, so this capture goes there directly rather than wait for the client
+    xSemaphoreTake(s_arena_lock, portMAX_DELAY);
+    uint32_t readers = s_arena_readers;
+    if (readers == 0) {
+        s_arena_image = 0;
+    }
+    xSemaphoreGive(s_arena_lock);
+    if (readers > 0) {
+        ESP_LOGW(TAG, "Capture arena in use by %u download(s), writing to flash directly", (unsigned)readers);
+        return NULL;
+    }
+    return s_arena;
+}
+#endif
+
+bool handshake_capture_acquire_ram(uint32_t id, const uint8_t **data, size_t *len) {
+#if CONFIG_CAPTURE_RAM_ARENA_SIZE > 0
+    if (!s_arena_lock) {
+        return false;
+    }
+    xSemaphoreTake(s_arena_lock, portMAX_DELAY);
+    if (s_arena_image == 0 || s_arena_id != id) {
+        xSemaphoreGive(s_arena_lock);
+        return false;
+    }
+    *data = s_arena;
+    *len = s_arena_image;
+    s_arena_readers++;
+    xSemaphoreGive(s_arena_lock);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void handshake_capture_release_ram(void) {
+#if CONFIG_CAPTURE_RAM_ARENA_SIZE > 0
+    xSemaphoreTake(s_arena_lock, portMAX_DELAY);
+    s_arena_readers--;
+    xSemaphoreGive(s_arena_lock);
+#endif
+}
+
+/**
+ * @brief Remove hashcat files whose store record was evicted by the log.
+ */
+static void prune_hc22000_files(void) {
+    DIR *dir = opendir("/spiffs");
+    if (!dir) {
+        return;
+    }
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        unsigned id;
+        capture_store_record_t rec;
+        if (sscanf(de->d_name, "cap%u.22000", &id) == 1 && !capture_store_stat(s_store, id, &rec)) {
+            char path[32];
+            handshake_capture_hc22000_path(id, path, sizeof(path));
+            unlink(path);
+        }
+    }
+    closedir(dir);
+}
+
+// Flash writes come from the writer task, and from the capture task once the writer has stopped
+static void on_pcap_flush(void *ctx, size_t len, bool ok, uint32_t cycles) {
+    capture_hist_add(CAPTURE_HIST_FLASH_WRITE, cycles);
+    if (ok) {
+        g_capture_metrics.flash_bytes += len;
+    } else {
+        g_capture_metrics.flash_errors++;
+    }
+}
+
+static bool store_sink_write(void *ctx, const void *data, size_t len) {
+    return capture_store_append(s_store, data, len) == ESP_OK;
+}
+
+static void pcap_config(pcap_writer_config_t *cfg, const char *if_desc) {
+    *cfg = (pcap_writer_config_t)PCAP_WRITER_DEFAULT_CONFIG();
+    cfg->buffer_size = CONFIG_CAPTURE_PCAP_BUFFER_SIZE;
+    cfg->flush_interval_ms = CONFIG_CAPTURE_PCAP_FLUSH_MS;
+    cfg->snaplen = CONFIG_CAPTURE_SNAPLEN;
+    cfg->on_flush = on_pcap_flush;
+    if (s_live.write) {
+        // Small and frequent: the client sees frames within a flush interval
+        cfg->buffer_size = PCAP_WRITER_BLOCK_SIZE;
+        cfg->flush_interval_ms = CONFIG_CAPTURE_LIVE_FLUSH_MS;
+        cfg->on_flush = NULL;   // not a flash write
+    }
+#ifdef CONFIG_CAPTURE_RADIOTAP
+    cfg->linktype = PCAP_LINKTYPE_IEEE802_11_RADIOTAP;
+#endif
+#ifdef CONFIG_CAPTURE_FORMAT_PCAPNG
+    cfg->format = PCAP_WRITER_FORMAT_PCAPNG;
+    cfg->if_name = "esp32-wlan";
+    cfg->if_description = if_desc;
+#endif
+}
+
+static uint32_t capture_result(void) {
+    uint32_t result = atomic_load(&s_target_msgs) & CAPTURE_RESULT_MSGS_MASK;
+    if (xEventGroupGetBits(s_events) & CAPTURE_EVT_PAIR) {
+        result |= CAPTURE_RESULT_HANDSHAKE;
+    }
+    return result;
+}
+
+// Live output: forward to the caller's sink and wake the job once it refuses data
+static bool live_sink_write(void *ctx, const void *data, size_t len) {
+    if (s_live.write(s_live.ctx, data, len)) {
+        return true;
+    }
+    xEventGroupSetBits(s_events, CAPTURE_EVT_LOST);
+    return false;
+}
+
+static void live_sink_close(void *ctx) {
+    if (s_live.close) {
+        s_live.close(s_live.ctx);
+        s_live.close = NULL;
+    }
+}
+
+/**
+ * @brief Open the pcap output: the live sink during a live capture, else a new store
+ *        record when a store is set, else the file.
+ */
+static pcap_writer_t *open_pcap(const uint8_t bssid[6], uint8_t channel, bool survey,
+                                const pcap_writer_config_t *cfg) {
+    if (s_live.write) {
+        const pcap_writer_sink_t sink = { .write = live_sink_write, .close = live_sink_close, .ctx = NULL };
+        return pcap_writer_open_sink(&sink, cfg);
+    }
+    if (!s_store) {
+        memset(&s_file_entry, 0, sizeof(s_file_entry));
+        s_file_entry.created = (uint32_t)time(NULL);
+        memcpy(s_file_entry.bssid, bssid, 6);
+        s_file_entry.channel = channel;
+        s_file_entry.survey = survey;
+        s_file_entry.pcapng = (cfg->format == PCAP_WRITER_FORMAT_PCAPNG);
+        return pcap_writer_open(HANDSHAKE_PCAP_PATH, cfg);
+    }
+
+    // Evict least recently recorded captures now rather than from the write path
+    capture_store_reserve(s_store, CONFIG_CAPTURE_STORE_RESERVE_KB * 1024);
+    prune_hc22000_files();
+
+    uint8_t info[CAPTURE_STORE_INFO_LEN] = {0};
+    capture_record_info_t *meta = (capture_record_info_t *)info;
+    memcpy(meta->bssid, bssid, 6);
+    meta->channel = channel;
+    meta->survey = survey;
+    meta->pcapng = (cfg->format == PCAP_WRITER_FORMAT_PCAPNG);
+    esp_err_t err = capture_store_begin(s_store, info, (uint32_t)time(NULL), &s_record);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot start a store record: %s", esp_err_to_name(err));
+        s_record = 0;
+        return NULL;
+    }
+    unlink(HANDSHAKE_PCAP_PATH);   // single-file capture of a store-less boot, no longer listed
+
+    const pcap_writer_sink_t sink = { .write = store_sink_write, .close = NULL, .ctx = NULL };
+    pcap_writer_t *w = pcap_writer_open_sink(&sink, cfg);
+    if (!w) {
+        capture_store_finish(s_store, 0);
+        capture_store_delete(s_store, s_record);
+        s_record = 0;
+    }
+    return w;
+}
+
+static void close_outputs(void) {
+    pcap_writer_stats_t st;
+    pcap_writer_get_stats(s_pcap, &st);
+    pcap_writer_close(s_pcap);
+    s_pcap = NULL;
+    if (s_live.write) {
+        return;   // nothing stored
+    }
+    if (s_store) {
+        capture_store_finish(s_store, capture_result());
+    }
+#if CONFIG_CAPTURE_RAM_ARENA_SIZE > 0
+    // Nothing was committed before close: the arena holds the whole file
+    if (st.bytes == 0 && s_arena_lock) {
+        xSemaphoreTake(s_arena_lock, portMAX_DELAY);
+        s_arena_image = st.pending;
+        s_arena_id = s_record;
+        xSemaphoreGive(s_arena_lock);
+    }
+#else
+    (void)st;
+#endif
+    if (s_hc_file) {
+        fclose(s_hc_file);
+        s_hc_file = NULL;
+        if (s_hc.lines == 0) {
+            char path[32];
+            handshake_capture_hc22000_path(s_record, path, sizeof(path));
+            unlink(path);   // absent file means "nothing crackable"
+        }
+    }
+    if (!s_store) {
+        s_file_entry.handshake_msgs = atomic_load(&s_target_msgs);
+        s_file_entry.handshake_complete = capture_result() & CAPTURE_RESULT_HANDSHAKE;
+    }
+}
+
+static size_t file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : 0;
+}
+
+static bool entry_from_record(const capture_store_record_t *rec, capture_entry_t *out) {
+    if (rec->open) {
+        return false;
+    }
+    const capture_record_info_t *meta = (const capture_record_info_t *)rec->info;
+    char path[32];
+    handshake_capture_hc22000_path(rec->id, path, sizeof(path));
+    memset(out, 0, sizeof(*out));
+    out->id = rec->id;
+    out->created = rec->created;
+    out->size = rec->length;
+    out->hc22000_size = file_size(path);
+    memcpy(out->bssid, meta->bssid, 6);
+    out->channel = meta->channel;
+    out->pcapng = meta->pcapng;
+    out->survey = meta->survey;
+    // Records recovered after a reset carry no result
+    if (rec->result != CAPTURE_STORE_RESULT_RECOVERED) {
+        out->handshake_msgs = rec->result & CAPTURE_RESULT_MSGS_MASK;
+        out->handshake_complete = rec->result & CAPTURE_RESULT_HANDSHAKE;
+    }
+    return true;
+}
+
+static bool file_entry(capture_entry_t *out) {
+    struct stat st;
+    if (s_pcap || stat(HANDSHAKE_PCAP_PATH, &st) != 0) {
+        return false;
+    }
+    *out = s_file_entry;
+    out->id = 0;
+    out->size = st.st_size;
+    out->hc22000_size = file_size(HANDSHAKE_HC22000_PATH);
+    return true;
+}
+
+void handshake_capture_set_store(capture_store_t *store) {
+    s_store = store;
+}
+
+capture_store_t *handshake_capture_store(void) {
+    return s_store;
+}
+
+size_t handshake_capture_list(capture_entry_t *out, size_t max) {
+    if (!s_store) {
+        return max > 0 && file_entry(out) ? 1 : 0;
+    }
+    capture_store_record_t recs[CAPTURE_STORE_MAX_RECORDS];
+    size_t count = capture_store_list(s_store, recs, CAPTURE_STORE_MAX_RECORDS);
+    size_t n = 0;
+    for (size_t i = 0; i < count && n < max; i++) {
+        if (entry_from_record(&recs[i], &out[n])) {
+            n++;
+        }
+    }
+    return n;
+}
+
+bool handshake_capture_find(uint32_t id, capture_entry_t *out) {
+    if (!s_store) {
+        return id == 0 && file_entry(out);
+    }
+    capture_store_record_t rec;
+    if (id == 0) {
+        // Newest finished record: skip one still being written
+        capture_store_record_t recs[CAPTURE_STORE_MAX_RECORDS];
+        size_t count = capture_store_list(s_store, recs, CAPTURE_STORE_MAX_RECORDS);
+        while (count > 0) {
+            if (entry_from_record(&recs[--count], out)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return capture_store_stat(s_store, id, &rec) && entry_from_record(&rec, out);
+}
+
+void handshake_capture_name(const capture_entry_t *entry, char *out, size_t len) {
+    if (!s_store) {
+        snprintf(out, len, "handshake.%s", entry->pcapng ? "pcapng" : "pcap");
+        return;
+    }
+    if (entry->survey) {
+        snprintf(out, len, "cap%u_survey.%s", (unsigned)entry->id, entry->pcapng ? "pcapng" : "pcap");
+        return;
+    }
+    const uint8_t *b = entry->bssid;
+    snprintf(out, len, "cap%u_%02x%02x%02x%02x%02x%02x.%s", (unsigned)entry->id,
+             b[0], b[1], b[2], b[3], b[4], b[5], entry->pcapng ? "pcapng" : "pcap");
+}
+
+void handshake_capture_hc22000_path(uint32_t id, char *out, size_t len) {
+    if (s_store) {
+        snprintf(out, len, HANDSHAKE_HC22000_FMT, (unsigned)id);
+    } else {
+        snprintf(out, len, "%s", HANDSHAKE_HC22000_PATH);
+    }
+}
+
+esp_err_t handshake_capture_delete(uint32_t id) {
+    if (s_store) {
+        esp_err_t err = capture_store_delete(s_store, id);
+        if (err != ESP_OK) {
+            return err;
+        }
+    } else if (id != 0 || s_pcap) {
+        return s_pcap ? ESP_ERR_INVALID_STATE : ESP_ERR_NOT_FOUND;
+    } else if (unlink(HANDSHAKE_PCAP_PATH) != 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    char path[32];
+    handshake_capture_hc22000_path(id, path, sizeof(path));
+    unlink(path);
+#if CONFIG_CAPTURE_RAM_ARENA_SIZE > 0
+    if (s_arena_lock) {
+        xSemaphoreTake(s_arena_lock, portMAX_DELAY);
+        if (s_arena_id == id) {
+            s_arena_image = 0;   // downloads in flight finish; arena_claim() skips the arena until then
+        }
+        xSemaphoreGive(s_arena_lock);
+    }
+#endif
+    ESP_LOGI(TAG, "Deleted capture %u", (unsigned)id);
+    return ESP_OK;
+}
+
+void handshake_capture_get_stats(capture_stats_t *out) {
+    out->frames_seen = atomic_load(&s_frames_seen);
+    out->frames_written = atomic_load(&s_frames_written);
+    out->frames_duplicate = atomic_load(&s_frames_duplicate);
+    out->write_errors = atomic_load(&s_write_errors);
+    out->bytes_written = atomic_load(&s_bytes_written);
+    out->ring_drops = atomic_load(&s_ring.dropped);
+    out->ring_high_water = atomic_load(&s_ring.high_water);
+    out->ring_used = s_ring.slots ? capture_ring_used(&s_ring) : 0;
+    out->ring_slots = s_ring.slots ? capture_ring_capacity(&s_ring) : 0;
+    out->ring_large_slots = s_ring.slots ? capture_ring_class_slots(&s_ring, CAPTURE_RING_LARGE) : 0;
+    out->ring_large_high_water = atomic_load(&s_ring.slab[CAPTURE_RING_LARGE].high_water);
+    out->ring_small_free = s_ring.slots ? capture_ring_class_slots(&s_ring, CAPTURE_RING_SMALL) -
+                                          capture_ring_class_used(&s_ring, CAPTURE_RING_SMALL) : 0;
+    out->ring_large_free = s_ring.slots ? capture_ring_class_slots(&s_ring, CAPTURE_RING_LARGE) -
+                                          capture_ring_class_used(&s_ring, CAPTURE_RING_LARGE) : 0;
+    out->ring_small_size = RING_SMALL_SIZE;
+    out->ring_bytes = s_ring.slots ? s_ring.bytes : 0;
+    out->eapol_frames = s_filter.stats.eapol;
+    out->beacons = s_filter.stats.beacons;
+    out->other_frames = s_filter.stats.other;
+    out->frames_filtered = s_filter.stats.dropped + s_filter.stats.foreign;
+    out->frames_foreign = s_filter.stats.foreign;
+    out->handshake_msgs = atomic_load(&s_target_msgs);
+    out->hashes = s_hc.lines;
+    out->handshake_complete = s_events && (xEventGroupGetBits(s_events) & CAPTURE_EVT_PAIR);
+    out->capture_id = s_store ? s_record : 0;
+}
+
+const char *handshake_capture_profile_str(capture_profile_t profile) {
+    return profile < CAPTURE_PROFILE_COUNT ? s_profiles[profile].name : "?";
+}
+
+bool handshake_capture_profile_parse(const char *name, capture_profile_t *out) {
+    for (int i = 0; i < CAPTURE_PROFILE_COUNT; i++) {
+        if (strcmp(name, s_profiles[i].name) == 0) {
+            *out = (capture_profile_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Open the outputs, start the writer and enter promiscuous mode on `channel`
+ *        with the driver filters and classifier of `profile`.
+ */
+static esp_err_t capture_begin(const uint8_t bssid[6], uint8_t channel, bool survey, capture_profile_t profile,
+                               const char *if_desc) {
+    const capture_profile_desc_t *desc = &s_profiles[profile < CAPTURE_PROFILE_COUNT ? profile : 0];
+    memcpy(s_target, bssid, sizeof(s_target));
+    g_capture_metrics.captures++;
 
     // Initialize PCAP writer
-    pcap_writer = pcap_writer_init("/spiffs/handshake.pcap");
-    if (!pcap_writer) {
+    pcap_writer_config_t pcap_cfg;
+    pcap_config(&pcap_cfg, if_desc);
+#if CONFIG_CAPTURE_RAM_ARENA_SIZE > 0
+    // A live stream goes out as it is written, never through the arena
+    pcap_cfg.arena = s_live.write ? NULL : arena_claim();
+    pcap_cfg.arena_size = pcap_cfg.arena ? CONFIG_CAPTURE_RAM_ARENA_SIZE : 0;
+#endif
+    s_pcap = open_pcap(bssid, channel, survey, &pcap_cfg);
+    if (!s_pcap) {
         ESP_LOGE(TAG, "Failed to initialize pcap_writer");
         return ESP_FAIL;
     }
+    hc22000_init(&s_hc, hc_emit, NULL);
+    if (!s_live.write) {
+        char hc_path[32];
+        handshake_capture_hc22000_path(s_record, hc_path, sizeof(hc_path));
+        s_hc_file = fopen(hc_path, "w");
+        if (!s_hc_file) {
+            ESP_LOGW(TAG, "Cannot create %s, capturing pcap only", hc_path);
+        }
+    }
 
-    // Save original promiscuous callback
-    orig_cb = esp_wifi_set_promiscuous_rx_cb(promisc_cb);
+    frame_filter_set_profile(&s_filter, desc->classify);
+#ifdef CONFIG_CAPTURE_TARGET_ONLY
+    // Neighbouring networks never reach the ring; surveys have no target and keep all
+    frame_filter_set_targets(&s_filter, survey ? NULL : (const uint8_t (*)[6])bssid, survey ? 0 : 1);
+#else
+    frame_filter_set_targets(&s_filter, NULL, 0);
+#endif
+    esp_err_t err = writer_start();
+    if (err != ESP_OK) {
+        close_outputs();
+        return err;
+    }
+
+    // Unwanted classes are dropped in the driver, before the callback copies anything
+    const wifi_promiscuous_filter_t filter = { .filter_mask = desc->filter_mask };
+    esp_wifi_set_promiscuous_filter(&filter);
+    if (desc->ctrl_mask) {
+        const wifi_promiscuous_filter_t ctrl = { .filter_mask = desc->ctrl_mask };
+        esp_wifi_set_promiscuous_ctrl_filter(&ctrl);
+    }
+    esp_wifi_set_promiscuous_rx_cb(promisc_cb);
 
     // Start promiscuous mode
     err = esp_wifi_set_promiscuous(true);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set promiscuous mode: %d", err);
+        writer_stop();
+        close_outputs();
+        return err;
+    }
+    esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    return ESP_OK;
+}
+
+/**
+ * @brief Leave promiscuous mode, flush the ring and close the outputs.
+ */
+static void capture_end(void) {
+    // Stop promiscuous mode; no more callbacks after this returns
+    esp_wifi_set_promiscuous(false);
+
+    // Flush whatever is still queued, then close the output files
+    writer_stop();
+    close_outputs();
+}
+
+esp_err_t handshake_deauth_and_capture(const uint8_t bssid[6], uint8_t channel, uint32_t duration_ms,
+                                       capture_profile_t profile) {
+    char if_desc[80];
+    snprintf(if_desc, sizeof(if_desc), "ESP32 promiscuous, channel %u, target " MACSTR ", %s",
+             channel, MAC2STR(bssid), handshake_capture_profile_str(profile));
+    esp_err_t err = capture_begin(bssid, channel, false, profile, if_desc);
+    if (err != ESP_OK) {
         return err;
     }
 
     // Deauth broadcast frame sending (simplified, customize as needed)
     // ... your deauth logic here ...
 
-    // Wait for handshake capture timeout (e.g. 15 seconds)
-    int64_t start_time = esp_timer_get_time() / 1000;
-    while ((esp_timer_get_time() / 1000) - start_time < 15000) {
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+    // Wait until the tracker reports the handshake, or duration_ms at most
+    int64_t start_us = esp_timer_get_time();
+    EventBits_t bits = xEventGroupWaitBits(s_events, CAPTURE_EVT_DONE, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(duration_ms));
+    ESP_LOGI(TAG, "%s after %u ms", (bits & CAPTURE_EVT_DONE) ? "Handshake complete" : "Capture window elapsed",
+             (unsigned)((esp_timer_get_time() - start_us) / 1000));
+
+    capture_end();
+    return ESP_OK;
+}
+
+esp_err_t handshake_live_capture(const uint8_t bssid[6], uint8_t channel, uint32_t duration_ms,
+                                 capture_profile_t profile, const pcap_writer_sink_t *sink) {
+    static const uint8_t no_target[6] = {0};
+    char if_desc[80];
+    if (bssid) {
+        snprintf(if_desc, sizeof(if_desc), "ESP32 promiscuous, channel %u, target " MACSTR ", %s, live",
+                 channel, MAC2STR(bssid), handshake_capture_profile_str(profile));
+    } else {
+        snprintf(if_desc, sizeof(if_desc), "ESP32 promiscuous, channel %u, %s, live",
+                 channel, handshake_capture_profile_str(profile));
     }
 
-    // Stop promiscuous mode
-    esp_wifi_set_promiscuous(false);
+    s_live = *sink;
+    // Without a target the whole channel is streamed, as in a survey
+    esp_err_t err = capture_begin(bssid ? bssid : no_target, channel, bssid == NULL, profile, if_desc);
+    if (err != ESP_OK) {
+        // The sink is closed exactly once, by the writer if it got that far
+        live_sink_close(NULL);
+        memset(&s_live, 0, sizeof(s_live));
+        return err;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    EventBits_t bits = xEventGroupWaitBits(s_events, CAPTURE_EVT_LOST, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(duration_ms));
+    ESP_LOGI(TAG, "Live capture %s after %u ms, %u frames dropped by the ring",
+             (bits & CAPTURE_EVT_LOST) ? "client gone" : "window elapsed",
+             (unsigned)((esp_timer_get_time() - start_us) / 1000), atomic_load(&s_ring.dropped));
+
+    capture_end();
+    memset(&s_live, 0, sizeof(s_live));
+    return ESP_OK;
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Survey: channel hopping with activity-weighted dwell
+
+static survey_channel_t s_survey[SURVEY_CHANNELS];
+static portMUX_TYPE s_survey_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_uint s_survey_current;     // channel being listened to, 0 when not surveying
+
+/**
+ * @brief Dwell for the next visit: SURVEY_DWELL_MIN_MS for an idle channel, scaled up to
+ *        SURVEY_DWELL_MAX_MS for the busiest one. Every channel is visited each round, so
+ *        a channel that goes quiet (or wakes up) is noticed within a round.
+ */
+static uint32_t survey_dwell(const survey_channel_t *ch, uint32_t max_score) {
+    if (max_score == 0) {
+        return CONFIG_SURVEY_DWELL_MIN_MS;
+    }
+    return CONFIG_SURVEY_DWELL_MIN_MS +
+           (uint32_t)((uint64_t)(CONFIG_SURVEY_DWELL_MAX_MS - CONFIG_SURVEY_DWELL_MIN_MS) * ch->score / max_score);
+}
+
+static void survey_run(uint32_t duration_ms) {
+    int64_t end_us = esp_timer_get_time() + (int64_t)duration_ms * 1000;
+    while (esp_timer_get_time() < end_us) {
+        uint32_t max_score = 0;
+        for (int i = 0; i < SURVEY_CHANNELS; i++) {
+            max_score = s_survey[i].score > max_score ? s_survey[i].score : max_score;
+        }
+        for (int i = 0; i < SURVEY_CHANNELS; i++) {
+            survey_channel_t *ch = &s_survey[i];
+            int64_t left_ms = (end_us - esp_timer_get_time()) / 1000;
+            if (left_ms <= 0) {
+                break;
+            }
+            uint32_t dwell = survey_dwell(ch, max_score);
+            dwell = dwell < left_ms ? dwell : (uint32_t)left_ms;
+
+            // The classifier counters are only written by the Wi-Fi task; reading them here is a snapshot
+            uint32_t seen = atomic_load(&s_frames_seen);
+            uint32_t eapol = s_filter.stats.eapol;
+            uint32_t beacons = s_filter.stats.beacons;
+            esp_wifi_set_channel(ch->channel, WIFI_SECOND_CHAN_NONE);
+            atomic_store(&s_survey_current, ch->channel);
+            vTaskDelay(pdMS_TO_TICKS(dwell));
+            seen = atomic_load(&s_frames_seen) - seen;
+            eapol = s_filter.stats.eapol - eapol;
+            beacons = s_filter.stats.beacons - beacons;
+
+            // Activity per second, an EWMA over visits (weight 1/4 for the newest)
+            uint32_t sample = (uint32_t)((uint64_t)(seen + SURVEY_EAPOL_WEIGHT * eapol +
+                                                    SURVEY_BEACON_WEIGHT * beacons) * 1000 / dwell);
+            taskENTER_CRITICAL(&s_survey_lock);
+            ch->score = ch->visits ? (3 * ch->score + sample) / 4 : sample;
+            ch->visits++;
+            ch->dwell_ms = dwell;
+            ch->listen_ms += dwell;
+            ch->frames += seen;
+            ch->eapol += eapol;
+            ch->beacons += beacons;
+            taskEXIT_CRITICAL(&s_survey_lock);
+        }
+    }
+    atomic_store(&s_survey_current, 0);
+}
 
-    // Close pcap file
-    pcap_writer_close(pcap_writer);
+esp_err_t handshake_survey_capture(uint32_t duration_ms, capture_profile_t profile) {
+    static const uint8_t no_target[6] = {0};
 
+    taskENTER_CRITICAL(&s_survey_lock);
+    memset(s_survey, 0, sizeof(s_survey));
+    for (int i = 0; i < SURVEY_CHANNELS; i++) {
+        s_survey[i].channel = i + 1;
+    }
+    taskEXIT_CRITICAL(&s_survey_lock);
+
+    char if_desc[64];
+    snprintf(if_desc, sizeof(if_desc), "ESP32 promiscuous, channel hopping survey, %s",
+             handshake_capture_profile_str(profile));
+    esp_err_t err = capture_begin(no_target, 1, true, profile, if_desc);
+    if (err != ESP_OK) {
+        return err;
+    }
+    survey_run(duration_ms);
+    capture_end();
+
+    ESP_LOGI(TAG, "Survey done: %u EAPOL, %u beacons, %u hashes",
+             (unsigned)s_filter.stats.eapol, (unsigned)s_filter.stats.beacons, (unsigned)s_hc.lines);
     return ESP_OK;
 }
+
+uint8_t handshake_survey_channels(survey_channel_t *out) {
+    taskENTER_CRITICAL(&s_survey_lock);
+    memcpy(out, s_survey, sizeof(s_survey));
+    taskEXIT_CRITICAL(&s_survey_lock);
+    return atomic_load(&s_survey_current);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Synthetic source (benchmarks)
+
+// What the radio would report for an injected frame: channel 6, 6 Mb/s
+static const wifi_pkt_rx_ctrl_t s_synthetic_rx = {
+    .rssi = -40, .rate = 11, .noise_floor = -95, .channel = 6,
+};
+static bool s_synthetic_record = false;   // output is a store record, not HANDSHAKE_BENCH_PATH
+static uint32_t s_record_before = 0;
+
+esp_err_t handshake_capture_synthetic_start(bool to_spiffs, size_t *budget) {
+    memset(s_target, 0, sizeof(s_target));
+    pcap_writer_config_t cfg;
+    pcap_config(&cfg, "ESP32 synthetic frames (benchmark)");
+
+    s_record_before = s_record;
+    s_synthetic_record = s_store && !to_spiffs;
+    *budget = 0;
+    if (s_synthetic_record) {
+        // Contiguous free log space: the record's sector rounding and erase-ahead come off it
+        size_t used, total;
+        capture_store_usage(s_store, &used, &total);
+        if (total > used + 2 * PCAP_WRITER_BLOCK_SIZE) {
+            *budget = total - used - 2 * PCAP_WRITER_BLOCK_SIZE;
+        }
+        esp_err_t err = capture_store_begin(s_store, NULL, (uint32_t)time(NULL), &s_record);
+        if (err != ESP_OK) {
+            s_record = s_record_before;
+            return err;
+        }
+        const pcap_writer_sink_t sink = { .write = store_sink_write, .close = NULL, .ctx = NULL };
+        s_pcap = pcap_writer_open_sink(&sink, &cfg);
+    } else {
+        // Leave half of the free space to SPIFFS garbage collection
+        size_t total = 0, used = 0;
+        if (esp_spiffs_info(NULL, &total, &used) == ESP_OK && total > used) {
+            *budget = (total - used) / 2;
+        }
+        s_pcap = pcap_writer_open(HANDSHAKE_BENCH_PATH, &cfg);
+    }
+    if (!s_pcap) {
+        handshake_capture_synthetic_stop();
+        return ESP_FAIL;
+    }
+    hc22000_init(&s_hc, hc_emit, NULL);   // no s_hc_file: lines are discarded
+
+    frame_filter_set_profile(&s_filter, FRAME_PROFILE_HANDSHAKE);
+    frame_filter_set_targets(&s_filter, NULL, 0);
+    esp_err_t err = writer_start();
+    if (err != ESP_OK) {
+        handshake_capture_synthetic_stop();
+    }
+    return err;
+}
+
+bool handshake_capture_inject(const uint8_t *frame, uint32_t len) {
+    atomic_fetch_add_explicit(&s_frames_seen, 1, memory_order_relaxed);
+    return queue_frame(frame, len, &s_synthetic_rx) == CAPTURE_FRAME_KEPT;
+}
+
+void handshake_capture_synthetic_stop(void) {
+    if (s_writer_task) {
+        writer_stop();
+    }
+    if (s_pcap) {
+        pcap_writer_close(s_pcap);
+        s_pcap = NULL;
+    }
+    if (s_synthetic_record) {
+        capture_store_finish(s_store, 0);
+        capture_store_delete(s_store, s_record);
+        s_record = s_record_before;
+    } else {
+        unlink(HANDSHAKE_BENCH_PATH);
+    }
+}
@@ -1,15 +1,258 @@
 #pragma once
 #include "esp_err.h"
+#include "sdkconfig.h"
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "capture_store.h"
+#include "pcap_writer.h"
+
+#define HANDSHAKE_PCAP_PATH     "/spiffs/handshake.pcap"
+#define HANDSHAKE_HC22000_PATH  "/spiffs/handshake.22000"   // hashcat lines, absent if none
+#define HANDSHAKE_HC22000_FMT   "/spiffs/cap%u.22000"       // hashcat lines of store record %u
+#define HANDSHAKE_BENCH_PATH    "/spiffs/bench.pcap"        // scratch output of synthetic runs
+
+#define HANDSHAKE_PCAPNG_CONTENT_TYPE  "application/x-pcapng"
+#define HANDSHAKE_PCAP_CONTENT_TYPE    "application/vnd.tcpdump.pcap"
+
+/**
+ * @brief Metadata kept with each capture in the store (capture_store_record_t::info).
+ */
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t pcapng;            // 1 if the record is pcapng, 0 for classic pcap
+    uint8_t survey;            // 1 for a channel-hopping survey (no target, bssid/channel unset)
+} capture_record_info_t;
+
+// capture_store_record_t::result of a finished capture
+#define CAPTURE_RESULT_MSGS_MASK   0xff     // EAPOL_MSG_BIT() of the target messages seen
+#define CAPTURE_RESULT_HANDSHAKE   0x100    // crackable message pair captured
+
+/**
+ * @brief Counters for the current (or last) capture run.
+ */
+typedef struct {
+    uint32_t frames_seen;      // frames delivered to the promiscuous callback
+    uint32_t frames_written;   // frames appended to the PCAP file
+    uint32_t frames_duplicate; // repeated copies skipped by CONFIG_CAPTURE_DEDUP
+    uint32_t write_errors;     // frames the PCAP writer failed to append
+    uint32_t bytes_written;    // PCAP bytes captured (RAM arena and flash)
+    uint32_t ring_drops;       // frames dropped because the capture ring was full
+    uint32_t ring_high_water;  // max ring slots in use at once
+    uint32_t ring_used;        // ring slots in use right now
+    uint32_t ring_slots;       // ring capacity, small and large slots
+    uint32_t ring_large_slots; // ... of which hold up to CONFIG_CAPTURE_SNAPLEN bytes
+    uint32_t ring_large_high_water; // max large slots in use at once
+    uint32_t ring_small_free;  // small slots free right now
+    uint32_t ring_large_free;  // large slots free right now; the only ones for frames over ring_small_size
+    uint32_t ring_small_size;  // bytes per small slot
+    uint32_t ring_bytes;       // memory held by the ring (0 until the first capture)
+    uint32_t eapol_frames;     // EAPOL-Key frames kept by the classifier
+    uint32_t beacons;          // beacons / probe responses kept (one per BSSID)
+    uint32_t other_frames;     // further frames kept by the MGMT / FULL profiles
+    uint32_t frames_filtered;  // frames discarded by the classifier
+    uint32_t frames_foreign;   // ... of which did not involve the target BSS
+    uint32_t handshake_msgs;   // EAPOL_MSG_BIT() of each target handshake message seen
+    uint32_t hashes;           // hashcat 22000 lines written (any BSS on the channel without CONFIG_CAPTURE_TARGET_ONLY)
+    bool     handshake_complete; // target has a crackable message pair
+    uint32_t capture_id;       // capture being (or last) written, see capture_entry_t
+} capture_stats_t;
+
+/**
+ * @brief What a capture records. Each profile sets the driver's promiscuous
+ *        filter masks and the software classifier together, so frame classes
+ *        the profile discards are never handed up to the RX callback.
+ */
+typedef enum {
+    CAPTURE_PROFILE_HANDSHAKE = 0,   // mgmt + data up; EAPOL-Key and one beacon per BSS kept
+    CAPTURE_PROFILE_MGMT,            // mgmt only; every management frame kept, beacons once per BSS
+    CAPTURE_PROFILE_FULL,            // mgmt, data and control up; everything kept
+    CAPTURE_PROFILE_COUNT,
+} capture_profile_t;
+
+#if defined(CONFIG_CAPTURE_PROFILE_DEFAULT_FULL)
+#define CAPTURE_PROFILE_DEFAULT  CAPTURE_PROFILE_FULL
+#elif defined(CONFIG_CAPTURE_PROFILE_DEFAULT_MGMT)
+#define CAPTURE_PROFILE_DEFAULT  CAPTURE_PROFILE_MGMT
+#else
+#define CAPTURE_PROFILE_DEFAULT  CAPTURE_PROFILE_HANDSHAKE
+#endif
+
+/**
+ * @brief Short lowercase name of a profile ("handshake", "mgmt", "full").
+ */
+const char* handshake_capture_profile_str(capture_profile_t profile);
 
 /**
- * @brief Perform a 20 s deauth + handshake capture on the target AP.
- * 
+ * @brief Look a profile up by its name.
+ * @return false if the name is unknown.
+ */
+bool handshake_capture_profile_parse(const char* name, capture_profile_t* out);
+
+/**
+ * @brief Perform a deauth + handshake capture on the target AP.
+ *
  * @param bssid   6-byte MAC of the target AP.
  * @param channel Channel number (1‒13).
- * @param duration_ms Total time (ms) to send deauth + capture.
+ * @param duration_ms Upper bound (ms) for deauth + capture. Returns earlier as soon
+ *                    as the target's handshake is complete (see
+ *                    CONFIG_CAPTURE_WAIT_FULL_HANDSHAKE).
+ * @param profile What to record besides the handshake.
  * @return ESP_OK on success, error otherwise.
  *
- * After this returns, /spiffs/handshake.pcap contains any captured 4-way EAPOL packets.
+ * After this returns, a new capture (capture_stats_t::capture_id) holds any captured
+ * 4-way EAPOL packets and the hashcat lines derived from them (only if there were
+ * any); handshake_capture_get_stats() tells whether the handshake is complete.
+ */
+esp_err_t handshake_deauth_and_capture(const uint8_t bssid[6], uint8_t channel, uint32_t duration_ms,
+                                       capture_profile_t profile);
+
+/**
+ * @brief Live capture: the same classifier, ring and writer as a capture, but the pcap
+ *        stream goes to `sink` as it is produced; nothing is stored and no hashcat
+ *        lines are kept. The writer pushes CONFIG_CAPTURE_LIVE_FLUSH_MS worth (or 4 KB)
+ *        at a time. A slow sink stalls only the writer: frames then pile up in the
+ *        ring and, once it is full, are dropped in the RX callback and counted in
+ *        capture_stats_t::ring_drops.
+ * @param bssid   Target AP as in handshake_deauth_and_capture(), or NULL to stream
+ *                everything the profile keeps on `channel`.
+ * @param duration_ms Upper bound; returns earlier once the sink refuses data.
+ * @param sink    Output; its close() is called exactly once, also when this fails.
+ */
+esp_err_t handshake_live_capture(const uint8_t bssid[6], uint8_t channel, uint32_t duration_ms,
+                                 capture_profile_t profile, const pcap_writer_sink_t* sink);
+
+#define SURVEY_CHANNELS       13
+#define SURVEY_MAX_DURATION_S 3600
+#define SURVEY_EAPOL_WEIGHT   64   // activity score of one EAPOL-Key frame, in frames
+#define SURVEY_BEACON_WEIGHT  16   // ... of a beacon from a BSS not seen before
+
+/**
+ * @brief Per-channel state of the current (or last) survey.
+ */
+typedef struct {
+    uint8_t  channel;
+    uint32_t score;            // activity per second, EWMA over visits; drives the dwell
+    uint32_t dwell_ms;         // last dwell
+    uint32_t visits;
+    uint32_t listen_ms;        // total time spent on the channel
+    uint32_t frames;           // frames received there
+    uint32_t eapol;            // EAPOL-Key frames kept there
+    uint32_t beacons;          // new BSSes found there
+} survey_channel_t;
+
+/**
+ * @brief Receive-only survey: hop channels 1..SURVEY_CHANNELS for duration_ms, staying
+ *        longer where EAPOL and beacon activity is higher, recording every channel to one
+ *        new capture through the same pipeline (classifier, ring, pcap, hashcat lines).
+ *        Nothing is transmitted. With CAPTURE_PROFILE_MGMT no EAPOL reaches the
+ *        callback, so only new BSSes and frame counts steer the dwell.
+ */
+esp_err_t handshake_survey_capture(uint32_t duration_ms, capture_profile_t profile);
+
+/**
+ * @brief Copy the SURVEY_CHANNELS per-channel entries of the current (or last) survey.
+ * @return Channel being listened to, 0 if no survey is running.
+ */
+uint8_t handshake_survey_channels(survey_channel_t* out);
+
+/**
+ * @brief One finished capture, as listed for download.
+ *
+ * With a store every capture is a record and id is its record id. Without one
+ * there is only HANDSHAKE_PCAP_PATH, listed as id 0, overwritten by the next
+ * capture.
+ */
+typedef struct {
+    uint32_t id;
+    uint32_t created;          // time() when the capture started
+    uint32_t size;             // pcap bytes
+    uint32_t hc22000_size;     // bytes of hashcat lines, 0 if nothing crackable
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    bool     pcapng;
+    bool     survey;           // channel-hopping survey: bssid and channel are unset
+    uint32_t handshake_msgs;   // EAPOL_MSG_BIT() of each target handshake message seen
+    bool     handshake_complete;
+} capture_entry_t;
+
+/**
+ * @brief Write captures to the store from now on, instead of HANDSHAKE_PCAP_PATH.
+ */
+void handshake_capture_set_store(capture_store_t* store);
+
+/**
+ * @brief Store in use, or NULL when captures go to SPIFFS.
+ */
+capture_store_t* handshake_capture_store(void);
+
+/**
+ * @brief Copy up to `max` finished captures, oldest first.
+ * @return Number of entries copied.
+ */
+size_t handshake_capture_list(capture_entry_t* out, size_t max);
+
+/**
+ * @brief Look up a finished capture; id 0 means the newest one.
+ * @return false if there is no such capture.
+ */
+bool handshake_capture_find(uint32_t id, capture_entry_t* out);
+
+/**
+ * @brief Download name of a capture, e.g. "cap12_aabbccddeeff.pcapng".
+ */
+void handshake_capture_name(const capture_entry_t* entry, char* out, size_t len);
+
+/**
+ * @brief SPIFFS path of a capture's hashcat 22000 lines.
+ */
+void handshake_capture_hc22000_path(uint32_t id, char* out, size_t len);
+
+/**
+ * @brief Delete a finished capture with its hashcat lines and RAM image.
+ * @return ESP_ERR_NOT_FOUND if unknown, ESP_ERR_INVALID_STATE while it is written.
+ */
+esp_err_t handshake_capture_delete(uint32_t id);
+
+/**
+ * @brief Borrow a capture's pcap image from the RAM arena.
+ * @return false if that capture is not complete in RAM (arena disabled or
+ *         overflowed, an older capture, or a capture is running). On true, the
+ *         image stays valid until handshake_capture_release_ram(). No lock is
+ *         held meanwhile: a capture starting while the image is borrowed writes
+ *         to flash directly instead of into the arena.
+ */
+bool handshake_capture_acquire_ram(uint32_t id, const uint8_t** data, size_t* len);
+
+/**
+ * @brief Return the image borrowed by handshake_capture_acquire_ram().
+ */
+void handshake_capture_release_ram(void);
+
+/**
+ * @brief Snapshot the capture counters. Safe to call while a capture is running.
+ */
+void handshake_capture_get_stats(capture_stats_t* out);
+
+/**
+ * @brief Run the capture pipeline (classifier, ring, writer, flash) on frames given to
+ *        handshake_capture_inject() instead of the radio, for benchmarks.
+ *
+ * Output goes to a scratch store record, or to HANDSHAKE_BENCH_PATH with `to_spiffs`
+ * or without a store, and is deleted again by handshake_capture_synthetic_stop().
+ * Nothing is evicted: `budget` is set to the bytes that fit in the free space.
+ * Must not overlap a capture (run it from the capture job task).
+ */
+esp_err_t handshake_capture_synthetic_start(bool to_spiffs, size_t* budget);
+
+/**
+ * @brief Feed one 802.11 frame (no FCS) as the RX callback would. One task only.
+ * @return false if the classifier or a full ring rejected it.
+ */
+bool handshake_capture_inject(const uint8_t* frame, uint32_t len);
+
+/**
+ * @brief Drain the ring, close the output and delete it.
  */
-esp_err_t handshake_deauth_and_capture(const uint8_t bssid[6], uint8_t channel, uint32_t duration_ms);
+void handshake_capture_synthetic_stop(void);
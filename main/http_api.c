@@ -0,0 +1,577 @@
+/**
+ * http_api.c
+ *
+ * JSON endpoints for scripts and the web UI:
+ *  - "/api/scan[?refresh=1]" → AP and client table
+ *  - "/api/captures"         → captures available for download (DELETE ?id=N removes one)
+ *  - "/api/status[?id=N]"    → device health plus the latest (or given) capture job
+ *  - "/status?id=N"          → flat progress object of one capture job
+ *  - "/metrics"              → capture-path counters and latency histograms (Prometheus text)
+ *  - "/api/capture" (POST)   → ?bssid=AA:BB:CC:DD:EE:FF&chan=N[&seconds=N][&profile=NAME] queues
+ *                              a deauth+capture job; poll the returned /status URL
+ *  - "/api/survey[?id=N]"    → latest (or given) survey job with per-channel dwell and activity;
+ *                              POST ?seconds=N[&profile=NAME] starts a receive-only channel-hopping survey
+ *  - "/api/bench[?id=N]"     → device description plus the latest (or given) benchmark run;
+ *                              POST starts one (?rate=&len=&seconds=&target=spiffs)
+ *
+ * Output is produced with json_writer straight into httpd chunks; nothing
+ * is allocated on the heap per request.
+ */
+
+#include "http_api.h"
+#include "json_writer.h"
+#include "http_resp.h"
+#include "scan_cache.h"
+#include "capture_job.h"
+#include "wifi_station.h"
+#include "capture_metrics.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_chip_info.h"
+#include "esp_flash.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define JSON_BUF_SIZE  128   // staging only, http_resp_t does the coalescing
+#define CAPTURE_DEFAULT_S  20
+#define CAPTURE_MAX_S      600
+
+static void json_response_begin(httpd_req_t* req, http_resp_t* out, json_writer_t* w,
+                                char* buf, size_t cap)
+{
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    http_resp_init(out, req);
+    json_init(w, buf, cap, http_resp_write, out);
+}
+
+static esp_err_t json_response_end(http_resp_t* out, json_writer_t* w)
+{
+    esp_err_t ret = json_finish(w);
+    return ret == ESP_OK ? http_resp_end(out) : ret;
+}
+
+static bool query_value(httpd_req_t* req, const char* key, char* val, size_t val_len)
+{
+    char query[96];
+    return httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+           httpd_query_key_value(query, key, val, val_len) == ESP_OK;
+}
+
+// Job fields, written into the object currently open
+static void write_job_fields(json_writer_t* w, const capture_job_t* job)
+{
+    int64_t end_us = job->finished_us ? job->finished_us : esp_timer_get_time();
+    uint32_t elapsed_ms = job->started_us ? (uint32_t)((end_us - job->started_us) / 1000) : 0;
+
+    json_kv_uint(w, "id", job->id);
+    json_kv_str(w, "kind", capture_job_kind_str(job->kind));
+    json_kv_str(w, "state", capture_job_state_str(job->state));
+    if (job->kind != CAPTURE_JOB_BENCH) {
+        json_kv_str(w, "profile", handshake_capture_profile_str(job->profile));
+    }
+    json_kv_mac(w, "bssid", job->bssid);
+    json_kv_uint(w, "channel", job->channel);
+    json_kv_uint(w, "duration_ms", job->duration_ms);
+    json_kv_uint(w, "elapsed_ms", elapsed_ms);
+    json_kv_uint(w, "frames_seen", job->stats.frames_seen);
+    json_kv_uint(w, "eapol", job->stats.eapol_frames);
+    json_kv_uint(w, "other_frames", job->stats.other_frames);
+    json_kv_uint(w, "foreign_frames", job->stats.frames_foreign);
+    json_kv_uint(w, "handshake_msgs", job->stats.handshake_msgs);
+    json_kv_uint(w, "hashes", job->stats.hashes);
+    json_kv_bool(w, "handshake", job->stats.handshake_complete);
+    json_kv_uint(w, "bytes_written", job->stats.bytes_written);
+    json_kv_uint(w, "ring_drops", job->stats.ring_drops);
+    json_kv_uint(w, "duplicate_frames", job->stats.frames_duplicate);
+    json_kv_uint(w, "capture_id", job->stats.capture_id);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// URI: "/status?id=N"
+static esp_err_t status_get_handler(httpd_req_t* req)
+{
+    char id_str[12];
+    if (!query_value(req, "id", id_str, sizeof(id_str))) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing id");
+        return ESP_FAIL;
+    }
+    capture_job_t job;
+    if (!capture_job_get(strtoul(id_str, NULL, 10), &job)) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown job");
+        return ESP_FAIL;
+    }
+
+    http_resp_t out;
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &out, &w, buf, sizeof(buf));
+    json_obj_begin(&w);
+    write_job_fields(&w, &job);
+    json_obj_end(&w);
+    return json_response_end(&out, &w);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// URI: "/api/scan[?refresh=1]"
+static esp_err_t api_scan_handler(httpd_req_t* req)
+{
+    char refresh[4] = {0};
+    query_value(req, "refresh", refresh, sizeof(refresh));
+
+    static scan_entry_t aps[SCAN_CACHE_MAX_APS];             // handlers run one at a time
+    static scan_station_t stations[SCAN_CACHE_MAX_STATIONS];
+    if (strcmp(refresh, "1") == 0) {
+        scan_cache_refresh();
+    }
+    int64_t scan_us = 0;
+    size_t count = scan_cache_snapshot(aps, SCAN_CACHE_MAX_APS, &scan_us);
+    size_t sta_count = scan_cache_stations(stations, SCAN_CACHE_MAX_STATIONS);
+    int64_t now = esp_timer_get_time();
+
+    http_resp_t out;
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &out, &w, buf, sizeof(buf));
+    json_obj_begin(&w);
+    json_kv_int(&w, "scan_age_ms", scan_us ? (now - scan_us) / 1000 : -1);
+    json_key(&w, "aps");
+    json_arr_begin(&w);
+    for (size_t i = 0; i < count; i++) {
+        json_obj_begin(&w);
+        json_kv_mac(&w, "bssid", aps[i].bssid);
+        json_kv_str(&w, "ssid", aps[i].ssid);
+        json_kv_uint(&w, "channel", aps[i].channel);
+        json_kv_int(&w, "rssi", aps[i].rssi);
+        json_kv_uint(&w, "auth", aps[i].authmode);
+        json_kv_uint(&w, "age_ms", (now - aps[i].last_seen_us) / 1000);
+        json_kv_uint(&w, "frames", aps[i].frames);
+        json_kv_uint(&w, "beacons", aps[i].beacons);
+        json_kv_uint(&w, "clients", aps[i].stations);
+        json_obj_end(&w);
+    }
+    json_arr_end(&w);
+    json_key(&w, "clients");
+    json_arr_begin(&w);
+    for (size_t i = 0; i < sta_count; i++) {
+        json_obj_begin(&w);
+        json_kv_mac(&w, "mac", stations[i].mac);
+        json_kv_mac(&w, "bssid", stations[i].bssid);
+        json_kv_int(&w, "rssi", stations[i].rssi);
+        json_kv_uint(&w, "frames", stations[i].frames);
+        json_kv_uint(&w, "age_ms", (now - stations[i].last_seen_us) / 1000);
+        json_obj_end(&w);
+    }
+    json_arr_end(&w);
+    json_obj_end(&w);
+    return json_response_end(&out, &w);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// URI: "/api/captures"
+// GET lists every capture, oldest first; DELETE ?id=N removes one
+static esp_err_t api_captures_handler(httpd_req_t* req)
+{
+    static capture_entry_t caps[CAPTURE_STORE_MAX_RECORDS];   // handlers run one at a time
+    size_t count = handshake_capture_list(caps, CAPTURE_STORE_MAX_RECORDS);
+
+    http_resp_t out;
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &out, &w, buf, sizeof(buf));
+    json_obj_begin(&w);
+    json_kv_bool(&w, "busy", capture_job_busy());
+    capture_store_t* store = handshake_capture_store();
+    if (store) {
+        size_t used, total;
+        capture_store_usage(store, &used, &total);
+        json_kv_uint(&w, "store_used", used);
+        json_kv_uint(&w, "store_size", total);
+    }
+    json_key(&w, "captures");
+    json_arr_begin(&w);
+    char name[40], url[48];
+    for (size_t i = 0; i < count; i++) {
+        const capture_entry_t* c = &caps[i];
+        handshake_capture_name(c, name, sizeof(name));
+        json_obj_begin(&w);
+        json_kv_uint(&w, "id", c->id);
+        json_kv_str(&w, "name", name);
+        json_kv_mac(&w, "bssid", c->bssid);
+        json_kv_uint(&w, "channel", c->channel);
+        json_kv_bool(&w, "survey", c->survey);
+        json_kv_uint(&w, "created", c->created);
+        json_kv_uint(&w, "size", c->size);
+        json_kv_uint(&w, "handshake_msgs", c->handshake_msgs);
+        json_kv_bool(&w, "handshake", c->handshake_complete);
+        snprintf(url, sizeof(url), "/download?id=%u", (unsigned)c->id);
+        json_kv_str(&w, "url", url);
+        if (c->hc22000_size) {
+            json_kv_uint(&w, "hc22000_size", c->hc22000_size);
+            snprintf(url, sizeof(url), "/download?id=%u&format=22000", (unsigned)c->id);
+            json_kv_str(&w, "hc22000_url", url);
+        }
+        json_obj_end(&w);
+    }
+    json_arr_end(&w);
+    json_obj_end(&w);
+    return json_response_end(&out, &w);
+}
+
+static esp_err_t api_captures_delete_handler(httpd_req_t* req)
+{
+    char id_str[12];
+    if (!query_value(req, "id", id_str, sizeof(id_str))) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing id");
+        return ESP_FAIL;
+    }
+    esp_err_t err = handshake_capture_delete(strtoul(id_str, NULL, 10));
+    if (err == ESP_ERR_NOT_FOUND) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown capture");
+        return ESP_FAIL;
+    }
+    http_resp_t out;
+    char buf[64];
+    json_writer_t w;
+    if (err != ESP_OK) {
+        httpd_resp_set_status(req, "409 Conflict");
+    }
+    json_response_begin(req, &out, &w, buf, sizeof(buf));
+    json_obj_begin(&w);
+    json_kv_bool(&w, "deleted", err == ESP_OK);
+    json_obj_end(&w);
+    return json_response_end(&out, &w);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// URI: "/api/status[?id=N]"
+static esp_err_t api_status_handler(httpd_req_t* req)
+{
+    char id_str[12];
+    uint32_t id = query_value(req, "id", id_str, sizeof(id_str))
+                  ? strtoul(id_str, NULL, 10) : capture_job_latest_id();
+    capture_job_t job;
+    bool have_job = capture_job_get(id, &job);
+
+    http_resp_t out;
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &out, &w, buf, sizeof(buf));
+    json_obj_begin(&w);
+    json_kv_uint(&w, "uptime_ms", esp_timer_get_time() / 1000);
+    json_kv_uint(&w, "heap_free", esp_get_free_heap_size());
+    json_kv_uint(&w, "heap_min", esp_get_minimum_free_heap_size());
+    json_kv_str(&w, "ip", wifi_get_ip_str());
+    json_kv_bool(&w, "capture_busy", capture_job_busy());
+    json_key(&w, "job");
+    if (have_job) {
+        json_obj_begin(&w);
+        write_job_fields(&w, &job);
+        json_obj_end(&w);
+    } else {
+        json_obj_begin(&w);
+        json_obj_end(&w);
+    }
+    json_obj_end(&w);
+    return json_response_end(&out, &w);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// URI: "/metrics"
+static esp_err_t metrics_get_handler(httpd_req_t* req)
+{
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    http_resp_t out;
+    http_resp_init(&out, req);
+    esp_err_t ret = capture_metrics_write_prometheus(http_resp_write, &out);
+    return ret == ESP_OK ? http_resp_end(&out) : ret;
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// Common reply of the POST handlers that queue a job: 202 with where to poll it
+static esp_err_t job_accepted(httpd_req_t* req, const char* uri, uint32_t id)
+{
+    http_resp_t out;
+    char buf[96], url[32];
+    json_writer_t w;
+    httpd_resp_set_status(req, "202 Accepted");
+    json_response_begin(req, &out, &w, buf, sizeof(buf));
+    json_obj_begin(&w);
+    json_kv_uint(&w, "id", id);
+    snprintf(url, sizeof(url), "%s?id=%u", uri, (unsigned)id);
+    json_kv_str(&w, "url", url);
+    json_obj_end(&w);
+    return json_response_end(&out, &w);
+}
+
+static esp_err_t job_queue_full(httpd_req_t* req)
+{
+    httpd_resp_set_status(req, "409 Conflict");
+    httpd_resp_sendstr(req, "Capture queue full");
+    return ESP_OK;
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// URI: "/api/capture" (POST)
+// Queue a deauth+capture job, the JSON twin of /attack
+static esp_err_t api_capture_post_handler(httpd_req_t* req)
+{
+    char val[20];
+    uint8_t bssid[6];
+    unsigned b[6];
+    if (!query_value(req, "bssid", val, sizeof(val)) ||
+        sscanf(val, "%2x:%2x:%2x:%2x:%2x:%2x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing or bad bssid");
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < 6; i++) {
+        bssid[i] = (uint8_t)b[i];
+    }
+    uint32_t channel = query_value(req, "chan", val, sizeof(val)) ? strtoul(val, NULL, 10) : 0;
+    if (channel < 1 || channel > 13) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad chan");
+        return ESP_FAIL;
+    }
+    uint32_t seconds = query_value(req, "seconds", val, sizeof(val)) ? strtoul(val, NULL, 10)
+                                                                     : CAPTURE_DEFAULT_S;
+    if (seconds == 0 || seconds > CAPTURE_MAX_S) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad seconds");
+        return ESP_FAIL;
+    }
+    capture_profile_t profile = CAPTURE_PROFILE_DEFAULT;
+    if (query_value(req, "profile", val, sizeof(val)) && !handshake_capture_profile_parse(val, &profile)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad profile");
+        return ESP_FAIL;
+    }
+
+    uint32_t id;
+    if (capture_job_submit(bssid, (uint8_t)channel, seconds * 1000, profile, &id) != ESP_OK) {
+        return job_queue_full(req);
+    }
+    return job_accepted(req, "/status", id);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// URI: "/api/survey[?id=N]"
+// GET reports a survey job and the per-channel schedule, POST ?seconds=N[&profile=NAME] queues one
+static esp_err_t api_survey_get_handler(httpd_req_t* req)
+{
+    char id_str[12];
+    uint32_t id = query_value(req, "id", id_str, sizeof(id_str))
+                  ? strtoul(id_str, NULL, 10) : capture_job_latest_id_of(CAPTURE_JOB_SURVEY);
+    capture_job_t job;
+    bool have_job = capture_job_get(id, &job) && job.kind == CAPTURE_JOB_SURVEY;
+    // Channel stats belong to the survey that ran last, which need not be this job
+    bool own = have_job && id == capture_job_latest_id_of(CAPTURE_JOB_SURVEY) &&
+               job.state != CAPTURE_JOB_QUEUED;
+    survey_channel_t channels[SURVEY_CHANNELS];
+    uint8_t current = handshake_survey_channels(channels);
+
+    http_resp_t out;
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &out, &w, buf, sizeof(buf));
+    json_obj_begin(&w);
+    json_key(&w, "job");
+    json_obj_begin(&w);
+    if (have_job) {
+        write_job_fields(&w, &job);
+    }
+    json_obj_end(&w);
+    if (own) {
+        json_kv_uint(&w, "current_channel", current);
+        json_key(&w, "channels");
+        json_arr_begin(&w);
+        for (int i = 0; i < SURVEY_CHANNELS; i++) {
+            const survey_channel_t* c = &channels[i];
+            json_obj_begin(&w);
+            json_kv_uint(&w, "channel", c->channel);
+            json_kv_uint(&w, "score", c->score);
+            json_kv_uint(&w, "dwell_ms", c->dwell_ms);
+            json_kv_uint(&w, "visits", c->visits);
+            json_kv_uint(&w, "listen_ms", c->listen_ms);
+            json_kv_uint(&w, "frames", c->frames);
+            json_kv_uint(&w, "eapol", c->eapol);
+            json_kv_uint(&w, "beacons", c->beacons);
+            json_obj_end(&w);
+        }
+        json_arr_end(&w);
+    }
+    json_obj_end(&w);
+    return json_response_end(&out, &w);
+}
+
+static esp_err_t api_survey_post_handler(httpd_req_t* req)
+{
+    uint32_t seconds = CONFIG_SURVEY_DURATION_S;
+    char val[12];
+    if (query_value(req, "seconds", val, sizeof(val))) {
+        seconds = strtoul(val, NULL, 10);
+    }
+    if (seconds == 0 || seconds > SURVEY_MAX_DURATION_S) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad seconds");
+        return ESP_FAIL;
+    }
+    capture_profile_t profile = CAPTURE_PROFILE_DEFAULT;
+    if (query_value(req, "profile", val, sizeof(val)) && !handshake_capture_profile_parse(val, &profile)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad profile");
+        return ESP_FAIL;
+    }
+    uint32_t id;
+    if (capture_job_submit_survey(seconds * 1000, profile, &id) != ESP_OK) {
+        return job_queue_full(req);
+    }
+    return job_accepted(req, "/api/survey", id);
+}
+
+// ──────────────────────────────────────────────────────────────────────────────
+// URI: "/api/bench[?id=N]"
+// GET reports a run, POST ?rate=&len=&seconds=&target=spiffs queues one
+static void write_bench_result(json_writer_t* w, const capture_job_t* job)
+{
+    const capture_bench_config_t* c = &job->bench_cfg;
+    const capture_bench_result_t* r = &job->bench;
+    uint32_t ms = r->elapsed_ms ? r->elapsed_ms : 1;
+
+    json_key(w, "config");
+    json_obj_begin(w);
+    json_kv_uint(w, "rate", c->rate);
+    json_kv_uint(w, "frame_len", c->frame_len);
+    json_kv_uint(w, "duration_ms", c->duration_ms);
+    json_kv_str(w, "target", (c->spiffs || !handshake_capture_store()) ? "spiffs" : "store");
+    json_obj_end(w);
+    if (job->state != CAPTURE_JOB_DONE) {
+        json_kv_str(w, "error", job->state == CAPTURE_JOB_FAILED ? esp_err_to_name(job->result) : "");
+        return;
+    }
+    json_key(w, "result");
+    json_obj_begin(w);
+    json_kv_uint(w, "elapsed_ms", r->elapsed_ms);
+    json_kv_uint(w, "frames_offered", r->frames_offered);
+    json_kv_uint(w, "frames_written", r->frames_written);
+    json_kv_uint(w, "frames_per_s", (uint64_t)r->frames_written * 1000 / ms);
+    json_kv_uint(w, "bytes_written", r->bytes_written);
+    json_kv_uint(w, "flash_bytes", r->flash_bytes);
+    json_kv_uint(w, "flash_kb_per_s", r->flash_bytes / ms);   // bytes/ms
+    json_kv_uint(w, "flash_writes", r->flash_writes);
+    json_kv_uint(w, "flash_write_avg_us", r->flash_write_avg_us);
+    json_kv_uint(w, "flash_errors", r->flash_errors);
+    json_kv_uint(w, "ring_slots", r->ring_slots);
+    json_kv_uint(w, "ring_high_water", r->ring_high_water);
+    json_key(w, "ring_avg");
+    char avg[16];
+    snprintf(avg, sizeof(avg), "%u.%02u", (unsigned)(r->ring_avg_x100 / 100), (unsigned)(r->ring_avg_x100 % 100));
+    json_str(w, avg);
+    json_kv_uint(w, "ring_drops", r->ring_drops);
+    json_key(w, "cpu_busy_pct");
+    json_arr_begin(w);
+    for (int i = 0; i < CAPTURE_BENCH_MAX_CORES; i++) {
+        json_int(w, r->cpu_busy[i]);
+    }
+    json_arr_end(w);
+    json_kv_bool(w, "budget_hit", r->budget_hit);
+    json_obj_end(w);
+}
+
+static esp_err_t api_bench_get_handler(httpd_req_t* req)
+{
+    char id_str[12];
+    uint32_t id = query_value(req, "id", id_str, sizeof(id_str))
+                  ? strtoul(id_str, NULL, 10) : capture_job_latest_id_of(CAPTURE_JOB_BENCH);
+    capture_job_t job;
+    bool have_job = capture_job_get(id, &job) && job.kind == CAPTURE_JOB_BENCH;
+
+    esp_chip_info_t chip;
+    esp_chip_info(&chip);
+    uint32_t flash_size = 0;
+    esp_flash_get_size(NULL, &flash_size);
+
+    http_resp_t out;
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_response_begin(req, &out, &w, buf, sizeof(buf));
+    json_obj_begin(&w);
+    json_key(&w, "device");
+    json_obj_begin(&w);
+    json_kv_str(&w, "target", CONFIG_IDF_TARGET);
+    json_kv_uint(&w, "revision", chip.revision);
+    json_kv_uint(&w, "cores", chip.cores);
+    json_kv_uint(&w, "cpu_mhz", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    json_kv_uint(&w, "flash_size", flash_size);
+    capture_store_t* store = handshake_capture_store();
+    if (store) {
+        size_t used, total;
+        capture_store_usage(store, &used, &total);
+        json_kv_uint(&w, "store_size", total);
+    }
+    json_obj_end(&w);
+    json_key(&w, "job");
+    json_obj_begin(&w);
+    if (have_job) {
+        write_job_fields(&w, &job);
+        write_bench_result(&w, &job);
+    }
+    json_obj_end(&w);
+    json_obj_end(&w);
+    return json_response_end(&out, &w);
+}
+
+static esp_err_t api_bench_post_handler(httpd_req_t* req)
+{
+    capture_bench_config_t cfg;
+    capture_bench_default_config(&cfg);
+    char val[12];
+    // Range-check the parsed values before narrowing or scaling them, so nothing wraps into range
+    unsigned long rate = cfg.rate, len = cfg.frame_len, seconds = cfg.duration_ms / 1000;
+    if (query_value(req, "rate", val, sizeof(val))) {
+        rate = strtoul(val, NULL, 10);
+    }
+    if (query_value(req, "len", val, sizeof(val))) {
+        len = strtoul(val, NULL, 10);
+    }
+    if (query_value(req, "seconds", val, sizeof(val))) {
+        seconds = strtoul(val, NULL, 10);
+    }
+    if (query_value(req, "target", val, sizeof(val))) {
+        cfg.spiffs = strcmp(val, "spiffs") == 0;
+    }
+    if (len < CAPTURE_BENCH_MIN_FRAME_LEN || len > CAPTURE_BENCH_MAX_FRAME_LEN ||
+        seconds == 0 || seconds > CAPTURE_BENCH_MAX_DURATION_MS / 1000 ||
+        rate > CAPTURE_BENCH_MAX_RATE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad rate, len or seconds");
+        return ESP_FAIL;
+    }
+    cfg.rate = rate;
+    cfg.frame_len = len;
+    cfg.duration_ms = seconds * 1000;
+
+    uint32_t id;
+    if (capture_job_submit_bench(&cfg, &id) != ESP_OK) {
+        return job_queue_full(req);
+    }
+    return job_accepted(req, "/api/bench", id);
+}
+
+static const httpd_uri_t s_api_uris[] = {
+    { .uri = "/status",       .method = HTTP_GET,    .handler = status_get_handler,          .user_ctx = NULL },
+    { .uri = "/api/scan",     .method = HTTP_GET,    .handler = api_scan_handler,            .user_ctx = NULL },
+    { .uri = "/api/captures", .method = HTTP_GET,    .handler = api_captures_handler,        .user_ctx = NULL },
+    { .uri = "/api/captures", .method = HTTP_DELETE, .handler = api_captures_delete_handler, .user_ctx = NULL },
+    { .uri = "/api/status",   .method = HTTP_GET,    .handler = api_status_handler,          .user_ctx = NULL },
+    { .uri = "/metrics",      .method = HTTP_GET,    .handler = metrics_get_handler,         .user_ctx = NULL },
+    { .uri = "/api/capture",  .method = HTTP_POST,   .handler = api_capture_post_handler,    .user_ctx = NULL },
+    { .uri = "/api/survey",   .method = HTTP_GET,    .handler = api_survey_get_handler,      .user_ctx = NULL },
+    { .uri = "/api/survey",   .method = HTTP_POST,   .handler = api_survey_post_handler,     .user_ctx = NULL },
+    { .uri = "/api/bench",    .method = HTTP_GET,    .handler = api_bench_get_handler,       .user_ctx = NULL },
+    { .uri = "/api/bench",    .method = HTTP_POST,   .handler = api_bench_post_handler,      .user_ctx = NULL },
+};
+
+void http_api_register(httpd_handle_t server)
+{
+    for (size_t i = 0; i < sizeof(s_api_uris) / sizeof(s_api_uris[0]); i++) {
+        httpd_register_uri_handler(server, &s_api_uris[i]);
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "esp_http_server.h"
+
+/**
+ * @brief Register the JSON endpoints for machine clients:
+ *        /api/scan, /api/captures, /api/status and the /status job poll.
+ */
+void http_api_register(httpd_handle_t server);
@@ -0,0 +1,244 @@
+/**
+ * http_download.c
+ *
+ * Writes the status line and headers itself and pushes the body with
+ * httpd_send(), which lets us announce Content-Length / Content-Range for
+ * data we stream from flash rather than hold in RAM.
+ */
+
+#include "http_download.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static const char* TAG = "http_download";
+
+#define SEND_RETRIES  5   // consecutive socket timeouts tolerated per write
+
+static esp_err_t send_all(httpd_req_t* req, const char* buf, size_t len)
+{
+    int retries = 0;
+    while (len > 0) {
+        int n = httpd_send(req, buf, len);
+        if (n == HTTPD_SOCK_ERR_TIMEOUT && ++retries < SEND_RETRIES) {
+            continue;
+        }
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        retries = 0;
+        buf += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static void* alloc_buffer(size_t* size)
+{
+    void* buf = NULL;
+#if CONFIG_SPIRAM
+    buf = heap_caps_malloc(*size, MALLOC_CAP_SPIRAM);
+#endif
+    if (!buf) {
+        buf = heap_caps_malloc(*size, MALLOC_CAP_DEFAULT);
+    }
+    if (!buf) {
+        // Heap is tight: a small buffer is slower but still works
+        *size = 1024;
+        buf = heap_caps_malloc(*size, MALLOC_CAP_DEFAULT);
+    }
+    return buf;
+}
+
+/**
+ * @brief Parse "bytes=a-b", "bytes=a-" or "bytes=-n" against size.
+ * @return false if the range is malformed or unsatisfiable.
+ */
+static bool parse_range(const char* hdr, size_t size, size_t* start, size_t* end)
+{
+    if (strncmp(hdr, "bytes=", 6) != 0 || size == 0) {
+        return false;
+    }
+    const char* p = hdr + 6;
+    char* endp;
+    if (*p == '-') {
+        unsigned long suffix = strtoul(p + 1, &endp, 10);
+        if (endp == p + 1 || suffix == 0) {
+            return false;
+        }
+        *start = (suffix >= size) ? 0 : size - suffix;
+        *end = size - 1;
+        return true;
+    }
+    unsigned long a = strtoul(p, &endp, 10);
+    if (endp == p || *endp != '-' || a >= size) {
+        return false;
+    }
+    p = endp + 1;
+    unsigned long b = size - 1;
+    if (*p) {
+        b = strtoul(p, &endp, 10);
+        if (endp == p || b < a) {
+            return false;
+        }
+        if (b >= size) {
+            b = size - 1;
+        }
+    }
+    *start = a;
+    *end = b;
+    return true;
+}
+
+esp_err_t http_send_download(httpd_req_t* req, const download_src_t* src,
+                             const char* content_type, const char* filename)
+{
+    size_t start = 0, end = src->size ? src->size - 1 : 0;
+    bool partial = false;
+
+    char range[48] = {0};
+    if (httpd_req_get_hdr_value_len(req, "Range") > 0 &&
+        httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK) {
+        if (!parse_range(range, src->size, &start, &end)) {
+            char hdr[128];
+            int n = snprintf(hdr, sizeof(hdr),
+                "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                "Content-Range: bytes */%u\r\nContent-Length: 0\r\n\r\n", (unsigned)src->size);
+            return send_all(req, hdr, n);
+        }
+        partial = true;
+    }
+    size_t length = src->size ? end - start + 1 : 0;
+
+    char hdr[320];
+    int n = snprintf(hdr, sizeof(hdr),
+        "HTTP/1.1 %s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Disposition: attachment; filename=%s\r\n"
+        "Accept-Ranges: bytes\r\n"
+        "Content-Length: %u\r\n",
+        partial ? "206 Partial Content" : "200 OK", content_type, filename, (unsigned)length);
+    if (partial) {
+        n += snprintf(hdr + n, sizeof(hdr) - n, "Content-Range: bytes %u-%u/%u\r\n",
+                      (unsigned)start, (unsigned)end, (unsigned)src->size);
+    }
+    n += snprintf(hdr + n, sizeof(hdr) - n, "\r\n");
+    if (send_all(req, hdr, n) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    size_t buf_size = CONFIG_HTTP_DOWNLOAD_BUF_SIZE;
+    char* buf = alloc_buffer(&buf_size);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;   // headers are out; closing the socket signals the failure
+    }
+
+    esp_err_t ret = ESP_OK;
+    size_t off = start;
+    while (length > 0) {
+        size_t want = length < buf_size ? length : buf_size;
+        ssize_t r = src->read(src->ctx, off, buf, want);
+        if (r <= 0) {
+            ESP_LOGE(TAG, "Read failed at offset %u", (unsigned)off);
+            ret = ESP_FAIL;
+            break;
+        }
+        if (send_all(req, buf, r) != ESP_OK) {
+            ESP_LOGW(TAG, "Client went away at offset %u", (unsigned)off);
+            ret = ESP_FAIL;
+            break;
+        }
+        off += r;
+        length -= r;
+    }
+    heap_caps_free(buf);
+    return ret;
+}
+
+typedef struct {
+    const uint8_t* data;
+} mem_src_t;
+
+static ssize_t mem_read(void* ctx, size_t offset, void* buf, size_t len)
+{
+    memcpy(buf, ((const mem_src_t*)ctx)->data + offset, len);
+    return len;
+}
+
+esp_err_t http_send_buffer(httpd_req_t* req, const uint8_t* data, size_t len,
+                           const char* content_type, const char* filename)
+{
+    mem_src_t m = { .data = data };
+    download_src_t src = { .size = len, .read = mem_read, .ctx = &m };
+    return http_send_download(req, &src, content_type, filename);
+}
+
+typedef struct {
+    capture_store_t* store;
+    uint32_t         id;
+} record_src_t;
+
+static ssize_t record_read(void* ctx, size_t offset, void* buf, size_t len)
+{
+    const record_src_t* r = ctx;
+    return capture_store_read(r->store, r->id, offset, buf, len);
+}
+
+esp_err_t http_send_record(httpd_req_t* req, capture_store_t* store, uint32_t id,
+                           const char* content_type, const char* filename)
+{
+    capture_store_record_t rec;
+    if (!capture_store_stat(store, id, &rec) || rec.open) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Capture not found");
+        return ESP_ERR_NOT_FOUND;
+    }
+    record_src_t r = { .store = store, .id = id };
+    download_src_t src = { .size = rec.length, .read = record_read, .ctx = &r };
+    return http_send_download(req, &src, content_type, filename);
+}
+
+typedef struct {
+    int   fd;
+    off_t pos;
+} file_src_t;
+
+static ssize_t file_read(void* ctx, size_t offset, void* buf, size_t len)
+{
+    file_src_t* f = ctx;
+    if ((off_t)offset != f->pos) {
+        if (lseek(f->fd, offset, SEEK_SET) < 0) {
+            return -1;
+        }
+        f->pos = offset;
+    }
+    ssize_t r = read(f->fd, buf, len);
+    if (r > 0) {
+        f->pos += r;
+    }
+    return r;
+}
+
+esp_err_t http_send_file(httpd_req_t* req, const char* path,
+                         const char* content_type, const char* filename)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
+        return ESP_ERR_NOT_FOUND;
+    }
+    file_src_t f = { .fd = open(path, O_RDONLY), .pos = 0 };
+    if (f.fd < 0) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Cannot open file");
+        return ESP_FAIL;
+    }
+
+    download_src_t src = { .size = st.st_size, .read = file_read, .ctx = &f };
+    esp_err_t ret = http_send_download(req, &src, content_type, filename);
+    close(f.fd);
+    return ret;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "capture_store.h"
+
+/**
+ * Fixed-length downloads with HTTP Range support.
+ *
+ * The response is written straight to the socket with a Content-Length
+ * instead of chunked encoding, in CONFIG_HTTP_DOWNLOAD_BUF_SIZE pieces
+ * (PSRAM-backed when available), so interrupted downloads can resume.
+ */
+
+typedef struct {
+    size_t  size;                                                    // total bytes available
+    ssize_t (*read)(void* ctx, size_t offset, void* buf, size_t len); // bytes read, <0 on error
+    void*   ctx;
+} download_src_t;
+
+/**
+ * @brief Serve src as an attachment, honouring a single "Range: bytes=" request.
+ * @param content_type MIME type of the body.
+ * @param filename     Name suggested in Content-Disposition.
+ */
+esp_err_t http_send_download(httpd_req_t* req, const download_src_t* src,
+                             const char* content_type, const char* filename);
+
+/**
+ * @brief Serve a memory region via http_send_download().
+ */
+esp_err_t http_send_buffer(httpd_req_t* req, const uint8_t* data, size_t len,
+                           const char* content_type, const char* filename);
+
+/**
+ * @brief Serve a finished capture store record via http_send_download().
+ * @return ESP_ERR_NOT_FOUND (after sending 404) if the record does not exist.
+ */
+esp_err_t http_send_record(httpd_req_t* req, capture_store_t* store, uint32_t id,
+                           const char* content_type, const char* filename);
+
+/**
+ * @brief Serve a file from the VFS via http_send_download().
+ * @return ESP_ERR_NOT_FOUND (after sending 404) if the file does not exist.
+ */
+esp_err_t http_send_file(httpd_req_t* req, const char* path,
+                         const char* content_type, const char* filename);
@@ -0,0 +1,75 @@
+/**
+ * http_resp.c
+ */
+
+#include "http_resp.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+void http_resp_init(http_resp_t* r, httpd_req_t* req)
+{
+    r->req = req;
+    r->len = 0;
+    r->err = ESP_OK;
+}
+
+esp_err_t http_resp_flush(http_resp_t* r)
+{
+    if (r->len > 0 && r->err == ESP_OK) {
+        r->err = httpd_resp_send_chunk(r->req, r->buf, r->len);
+    }
+    r->len = 0;
+    return r->err;
+}
+
+esp_err_t http_resp_write(void* ctx, const char* data, size_t len)
+{
+    http_resp_t* r = ctx;
+    if (r->err != ESP_OK) {
+        return r->err;
+    }
+    if (r->len + len > sizeof(r->buf)) {
+        http_resp_flush(r);
+        // Anything that would fill the buffer on its own goes out as its own chunk
+        if (len >= sizeof(r->buf)) {
+            if (r->err == ESP_OK) {
+                r->err = httpd_resp_send_chunk(r->req, data, len);
+            }
+            return r->err;
+        }
+    }
+    memcpy(r->buf + r->len, data, len);
+    r->len += len;
+    return r->err;
+}
+
+esp_err_t http_resp_str(http_resp_t* r, const char* s)
+{
+    return http_resp_write(r, s, strlen(s));
+}
+
+esp_err_t http_resp_printf(http_resp_t* r, const char* fmt, ...)
+{
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        return r->err;
+    }
+    if ((size_t)n >= sizeof(line)) {
+        n = sizeof(line) - 1;
+    }
+    return http_resp_write(r, line, n);
+}
+
+esp_err_t http_resp_end(http_resp_t* r)
+{
+    http_resp_flush(r);
+    if (r->err == ESP_OK) {
+        r->err = httpd_resp_send_chunk(r->req, NULL, 0);
+    }
+    return r->err;
+}
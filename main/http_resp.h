@@ -0,0 +1,49 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stddef.h>
+
+/**
+ * Coalescing writer for chunked httpd responses.
+ *
+ * Every handler that produces its body piece by piece writes through this
+ * instead of calling httpd_resp_send_chunk() per piece. Output collects in a
+ * CONFIG_HTTP_RESP_BUF_SIZE buffer (one TCP segment by default) and leaves as
+ * one chunk when it fills, so a long listing goes out as a burst of full
+ * segments rather than a chunk header, a few dozen bytes and a trailer per
+ * row. The first send error is sticky: later writes are dropped and
+ * reported by http_resp_end().
+ */
+
+typedef struct {
+    httpd_req_t* req;
+    size_t       len;
+    esp_err_t    err;
+    char         buf[CONFIG_HTTP_RESP_BUF_SIZE];
+} http_resp_t;
+
+void http_resp_init(http_resp_t* r, httpd_req_t* req);
+
+/**
+ * @brief Append len bytes. Takes the http_resp_t as ctx, so it can be used
+ *        directly as a json_flush_fn or capture_metrics_write_fn.
+ */
+esp_err_t http_resp_write(void* ctx, const char* data, size_t len);
+
+esp_err_t http_resp_str(http_resp_t* r, const char* s);
+
+/**
+ * @brief Append formatted text; output longer than 256 bytes is truncated.
+ */
+esp_err_t http_resp_printf(http_resp_t* r, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Send what is buffered now, e.g. at the end of each step of a streamed response.
+ */
+esp_err_t http_resp_flush(http_resp_t* r);
+
+/**
+ * @brief Flush and terminate the chunked response.
+ * @return The first error seen, or ESP_OK.
+ */
+esp_err_t http_resp_end(http_resp_t* r);
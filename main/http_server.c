@@ -2,120 +2,89 @@
  * http_server.c
  *
  * Serves:
- *  - "/"       → redirects to "/scan"
- *  - "/scan"   → scans nearby Wi-Fi, lists SSIDs as clickable links
- *  - "/confirm?ssid=…&chan=…&bssid=…" → asks confirm/go-back
- *  - "/attack?ssid=…&chan=…&bssid=…"  → runs deauth+capture, then offers download
- *  - "/download" → serves /spiffs/handshake.pcap as attachment
+ *  - "/", "/scan", "/confirm", "/attack", "/captures", "/survey" → the web UI: one
+ *    gzip-compressed page (main/ui/index.html, compressed at build time and linked
+ *    into the image) that picks its view from the path and loads everything else
+ *    from the JSON API. Sent as-is with Content-Encoding: gzip and an ETag, so a
+ *    revisit costs a 304.
+ *  - "/scan?stream=1[&format=json]" → channel-by-channel scan, rows streamed as found
+ *  - "/status?id=…", "/api/…", "/metrics" → JSON and Prometheus endpoints, see http_api.c
+ *  - "/download[?id=N][&format=22000]" → serves a capture (default: the newest), or the
+ *    hashcat 22000 lines derived from it, as attachment (supports Range)
+ *  - "/live?chan=N[&bssid=…][&seconds=N][&profile=NAME]" → queues a live capture job
+ *    that streams pcap to this connection until it closes or the window ends;
+ *    nothing touches flash (e.g. curl -sN …/live?chan=6 | wireshark -k -i -)
  *
- * If handshake.pcap exists and the request is NOT /download, it is deleted and the user
- * is redirected to /scan. This frees up space automatically.
+ * Captures are only removed by an explicit delete or, with a capture store, by
+ * eviction of the oldest ones when the store runs out of room.
  */
 
 #include "http_server.h"
 #include "wifi_station.h"
+#include "scan_cache.h"
 #include "handshake_capture.h"
+#include "capture_job.h"
+#include "http_download.h"
+#include "http_api.h"
+#include "json_writer.h"
+#include "http_resp.h"
 #include "pcap_writer.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_vfs_spiffs.h"
 #include "esp_http_server.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <time.h>
+#include <stdatomic.h>
 
 static const char* TAG = "http_server";
 static httpd_handle_t s_server = NULL;
 
-// Forward declarations
-static bool handshake_exists(void);
-static bool check_and_clean(httpd_req_t* req);
+// Web UI image, see the ui_assets rule in main/CMakeLists.txt
+extern const uint8_t ui_index_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t ui_index_gz_end[]   asm("_binary_index_html_gz_end");
 
-static esp_err_t root_get_handler(httpd_req_t* req);
+// Forward declarations
+static esp_err_t ui_get_handler(httpd_req_t* req);
 static esp_err_t scan_get_handler(httpd_req_t* req);
-static esp_err_t confirm_get_handler(httpd_req_t* req);
-static esp_err_t attack_get_handler(httpd_req_t* req);
 static esp_err_t download_get_handler(httpd_req_t* req);
-
-static const httpd_uri_t uri_root = {
-    .uri      = "/",
-    .method   = HTTP_GET,
-    .handler  = root_get_handler,
-    .user_ctx = NULL
-};
-static const httpd_uri_t uri_scan = {
-    .uri      = "/scan",
-    .method   = HTTP_GET,
-    .handler  = scan_get_handler,
-    .user_ctx = NULL
-};
-static const httpd_uri_t uri_confirm = {
-    .uri      = "/confirm",
-    .method   = HTTP_GET,
-    .handler  = confirm_get_handler,
-    .user_ctx = NULL
-};
-static const httpd_uri_t uri_attack = {
-    .uri      = "/attack",
-    .method   = HTTP_GET,
-    .handler  = attack_get_handler,
-    .user_ctx = NULL
-};
-static const httpd_uri_t uri_download = {
-    .uri      = "/download",
-    .method   = HTTP_GET,
-    .handler  = download_get_handler,
-    .user_ctx = NULL
+static esp_err_t live_get_handler(httpd_req_t* req);
+
+// Every UI path gets the same page; "/scan" also carries the streamed sweep
+static const httpd_uri_t s_uris[] = {
+    { .uri = "/",         .method = HTTP_GET, .handler = ui_get_handler,       .user_ctx = NULL },
+    { .uri = "/scan",     .method = HTTP_GET, .handler = scan_get_handler,     .user_ctx = NULL },
+    { .uri = "/confirm",  .method = HTTP_GET, .handler = ui_get_handler,       .user_ctx = NULL },
+    { .uri = "/attack",   .method = HTTP_GET, .handler = ui_get_handler,       .user_ctx = NULL },
+    { .uri = "/captures", .method = HTTP_GET, .handler = ui_get_handler,       .user_ctx = NULL },
+    { .uri = "/survey",   .method = HTTP_GET, .handler = ui_get_handler,       .user_ctx = NULL },
+    { .uri = "/download", .method = HTTP_GET, .handler = download_get_handler, .user_ctx = NULL },
+    { .uri = "/live",     .method = HTTP_GET, .handler = live_get_handler,     .user_ctx = NULL },
 };
 
-/**
- * @brief Returns true if "/spiffs/handshake.pcap" exists.
- */
-static bool handshake_exists(void)
-{
-    struct stat st;
-    return (stat("/spiffs/handshake.pcap", &st) == 0);
-}
-
-/**
- * @brief If a handshake file exists and the requested URI != "/download",
- *        delete it and redirect to "/scan".
- * @return true if we performed the redirect/cleanup (caller should return ESP_OK).
- */
-static bool check_and_clean(httpd_req_t* req)
-{
-    if (handshake_exists()) {
-        if (strncmp(req->uri, "/download", 9) != 0) {
-            // Delete handshake.pcap
-            unlink("/spiffs/handshake.pcap");
-            // Redirect to /scan
-            httpd_resp_set_status(req, "302 Found");
-            httpd_resp_set_hdr(req, "Location", "/scan");
-            httpd_resp_send(req, NULL, 0);
-            return true;
-        }
-    }
-    return false;
-}
-
 httpd_handle_t start_webserver(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.stack_size = 8 * 1024; // 8 KB stack
+    config.max_uri_handlers = 24;
+    config.task_priority = CONFIG_HTTPD_TASK_PRIORITY;
+    config.core_id = CONFIG_HTTPD_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_HTTPD_TASK_CORE;
 
     if (httpd_start(&s_server, &config) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start HTTP server");
         return NULL;
     }
-    httpd_register_uri_handler(s_server, &uri_root);
-    httpd_register_uri_handler(s_server, &uri_scan);
-    httpd_register_uri_handler(s_server, &uri_confirm);
-    httpd_register_uri_handler(s_server, &uri_attack);
-    httpd_register_uri_handler(s_server, &uri_download);
+    for (size_t i = 0; i < sizeof(s_uris) / sizeof(s_uris[0]); i++) {
+        httpd_register_uri_handler(s_server, &s_uris[i]);
+    }
+    http_api_register(s_server);
     ESP_LOGI(TAG, "HTTP server started");
     return s_server;
 }
@@ -129,194 +98,342 @@ void stop_webserver(httpd_handle_t server)
 }
 
 // ──────────────────────────────────────────────────────────────────────────────
-// URI: "/"
-// Redirect straight to /scan
-static esp_err_t root_get_handler(httpd_req_t* req)
+// URI: "/", "/scan", "/confirm", "/attack", "/captures", "/survey"
+// The embedded UI page, gzip as stored; revalidated by ETag so revisits cost one 304
+static esp_err_t ui_get_handler(httpd_req_t* req)
 {
-    if (check_and_clean(req)) {
-        return ESP_OK;
+    static char etag[12];
+    size_t len = ui_index_gz_end - ui_index_gz_start;
+    if (!etag[0]) {
+        // FNV-1a of the image: changes exactly when the page does
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++) {
+            h = (h ^ ui_index_gz_start[i]) * 16777619u;
+        }
+        snprintf(etag, sizeof(etag), "\"%08x\"", (unsigned)h);
     }
-    httpd_resp_set_status(req, "302 Found");
-    httpd_resp_set_hdr(req, "Location", "/scan");
-    httpd_resp_send(req, NULL, 0);
-    return ESP_OK;
+
+    char match[sizeof(etag)];
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK &&
+        strcmp(match, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    httpd_resp_set_type(req, "text/html; charset=utf-8");
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char*)ui_index_gz_start, len);
 }
 
-// ──────────────────────────────────────────────────────────────────────────────
-// URI: "/scan"
-// Scan nearby APs and list them as clickable SSIDs
-static esp_err_t scan_get_handler(httpd_req_t* req)
+/**
+ * @brief Copy an SSID for HTML output, dropping characters that would break markup.
+ */
+static void html_escape_ssid(const char* ssid, char* out, size_t out_len)
 {
-    if (check_and_clean(req)) {
-        return ESP_OK;
+    size_t pos = 0;
+    for (int j = 0; ssid[j] && j < 32 && pos + 1 < out_len; j++) {
+        char c = ssid[j];
+        if (c == '"' || c == '<' || c == '>' || c == '&') {
+            continue;
+        }
+        out[pos++] = c;
     }
+    out[pos] = 0;
+}
 
-    uint16_t count = 0;
-    wifi_ap_record_t* ap_list = NULL;
-    if (wifi_scan_once(&count, &ap_list) != ESP_OK) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Scan failed");
-        return ESP_FAIL;
-    }
+typedef struct {
+    http_resp_t   out;
+    bool          json;
+    json_writer_t w;      // NDJSON output when json is set
+    char          buf[128];
+} scan_stream_t;
 
-    // Build a simple HTML page
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_sendstr_chunk(req,
-        "<!DOCTYPE html><html><head><meta charset=\"UTF-8\"><title>Scan Wi-Fi</title></head><body>"
-        "<h2>Select Network to Attack</h2><ul>");
-    for (int i = 0; i < count; i++) {
-        // Escape SSID for HTML
-        char ssid_esc[64] = {0};
-        int pos = 0;
-        for (int j = 0; j < ap_list[i].ssid_len && j < 31; j++) {
-            char c = (char)ap_list[i].ssid[j];
-            if (c == '"' || c == '<' || c == '>') {
-                continue;
-            }
-            ssid_esc[pos++] = c;
+static esp_err_t scan_stream_channel(uint8_t channel, const wifi_ap_record_t* records,
+                                     uint16_t count, void* ctx)
+{
+    scan_stream_t* st = ctx;
+    if (st->json) {
+        for (uint16_t i = 0; i < count; i++) {
+            json_obj_begin(&st->w);
+            json_kv_uint(&st->w, "channel", channel);
+            json_kv_mac(&st->w, "bssid", records[i].bssid);
+            json_kv_str(&st->w, "ssid", (const char*)records[i].ssid);
+            json_kv_int(&st->w, "rssi", records[i].rssi);
+            json_kv_uint(&st->w, "auth", records[i].authmode);
+            json_obj_end(&st->w);
+            json_newline(&st->w);
+        }
+        json_finish(&st->w);
+    } else {
+        char ssid[64];
+        for (uint16_t i = 0; i < count; i++) {
+            const wifi_ap_record_t* ap = &records[i];
+            html_escape_ssid((const char*)ap->ssid, ssid, sizeof(ssid));
+            http_resp_printf(&st->out,
+                "<li><a href=\"/confirm?ssid=%s&amp;rssi=%d&amp;chan=%d"
+                "&amp;bssid=%02x:%02x:%02x:%02x:%02x:%02x\">%s</a> (%d dBm, ch %d)</li>",
+                ssid, ap->rssi, channel,
+                ap->bssid[0], ap->bssid[1], ap->bssid[2],
+                ap->bssid[3], ap->bssid[4], ap->bssid[5],
+                ssid, ap->rssi, channel);
         }
-        ssid_esc[pos] = 0;
-
-        // Build link: /confirm?ssid=...&rssi=...&chan=...&bssid=...
-        char line[256];
-        snprintf(line, sizeof(line),
-            "<li><a href=\"/confirm?ssid=%s&amp;rssi=%d&amp;chan=%d"
-            "&amp;bssid=%02x:%02x:%02x:%02x:%02x:%02x\">%s</a></li>",
-            ssid_esc,
-            ap_list[i].rssi,
-            ap_list[i].primary,
-            ap_list[i].bssid[0], ap_list[i].bssid[1], ap_list[i].bssid[2],
-            ap_list[i].bssid[3], ap_list[i].bssid[4], ap_list[i].bssid[5],
-            ssid_esc);
-        httpd_resp_sendstr_chunk(req, line);
     }
-    httpd_resp_sendstr_chunk(req, "</ul></body></html>");
-    httpd_resp_sendstr_chunk(req, NULL);
+    // One burst per channel; a failed send means the client went away: stop sweeping
+    return http_resp_flush(&st->out);
+}
 
-    free(ap_list);
-    return ESP_OK;
+/**
+ * @brief Sweep channel by channel, sending each channel's APs as soon as it is done.
+ */
+static esp_err_t scan_stream(httpd_req_t* req, bool json)
+{
+    static scan_stream_t st;   // handlers run one at a time; keeps the buffer off the stack
+    st.json = json;
+    http_resp_init(&st.out, req);
+    json_init(&st.w, st.buf, sizeof(st.buf), http_resp_write, &st.out);
+
+    httpd_resp_set_type(req, json ? "application/x-ndjson" : "text/html");
+    if (!json) {
+        http_resp_str(&st.out,
+            "<!DOCTYPE html><html><head><meta charset=\"UTF-8\"><title>Scan Wi-Fi</title></head><body>"
+            "<h2>Select Network to Attack</h2><ul>");
+    }
+    esp_err_t ret = scan_cache_sweep(scan_stream_channel, &st);
+    if (ret == ESP_ERR_INVALID_STATE) {
+        http_resp_str(&st.out, json ? "{\"error\":\"capture in progress\"}\n"
+                                    : "</ul><p>Capture in progress, try again shortly</p>");
+    } else if (ret != ESP_OK) {
+        return ESP_FAIL;   // client disconnected mid-sweep
+    }
+    if (!json) {
+        http_resp_str(&st.out, "</ul><p><a href=\"/scan\">Done</a></p></body></html>");
+    }
+    return http_resp_end(&st.out);
 }
 
 // ──────────────────────────────────────────────────────────────────────────────
-// URI: "/confirm?ssid=XXX&rssi=YY&chan=ZZ&bssid=AA:BB:CC:DD:EE:FF"
-// Show “Confirm or Go Back” for the selected SSID/channel/BSSID
-static esp_err_t confirm_get_handler(httpd_req_t* req)
+// URI: "/scan[?stream=1[&format=json]]"
+// The UI page, or with stream=1 a live channel sweep
+static esp_err_t scan_get_handler(httpd_req_t* req)
 {
-    if (check_and_clean(req)) {
-        return ESP_OK;
+    char query[64], stream[4] = {0}, format[8] = {0};
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "stream", stream, sizeof(stream));
+        httpd_query_key_value(query, "format", format, sizeof(format));
     }
-
-    char ssid[33] = {0}, rssi_str[8] = {0}, chan_str[8] = {0}, bssid[18] = {0};
-    char buf[128];
-    httpd_req_get_url_query_str(req, buf, sizeof(buf));
-    httpd_query_key_value(buf, "ssid", ssid, sizeof(ssid));
-    httpd_query_key_value(buf, "rssi", rssi_str, sizeof(rssi_str));
-    httpd_query_key_value(buf, "chan", chan_str, sizeof(chan_str));
-    httpd_query_key_value(buf, "bssid", bssid, sizeof(bssid));
-
-    if (strlen(ssid) == 0 || strlen(bssid) != 17) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad parameters");
-        return ESP_FAIL;
+    if (strcmp(stream, "1") == 0) {
+        return scan_stream(req, strcmp(format, "json") == 0);
     }
+    return ui_get_handler(req);
+}
 
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_sendstr_chunk(req,
-        "<!DOCTYPE html><html><head><meta charset=\"UTF-8\"><title>Confirm</title></head><body>");
-    char line[256];
-    snprintf(line, sizeof(line),
-        "<h2>Confirm attack on SSID: <b>%s</b> (Channel %s)</h2>"
-        "<a href=\"/attack?ssid=%s&chan=%s&bssid=%s\">Confirm</a> &nbsp; "
-        "<a href=\"/scan\">Go Back</a>",
-        ssid, chan_str, ssid, chan_str, bssid);
-    httpd_resp_sendstr_chunk(req, line);
-    httpd_resp_sendstr_chunk(req, "</body></html>");
-    httpd_resp_sendstr_chunk(req, NULL);
-    return ESP_OK;
+/**
+ * @brief Read "id" from the query string (0 if absent) and, if format is given, "format".
+ */
+static uint32_t capture_query(httpd_req_t* req, char* format, size_t format_len)
+{
+    char query[48] = {0}, id_str[12] = {0};
+    if (format) {
+        format[0] = 0;
+    }
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) {
+        return 0;
+    }
+    if (format) {
+        httpd_query_key_value(query, "format", format, format_len);
+    }
+    httpd_query_key_value(query, "id", id_str, sizeof(id_str));
+    return strtoul(id_str, NULL, 10);
 }
 
 // ──────────────────────────────────────────────────────────────────────────────
-// URI: "/attack?ssid=XXX&chan=ZZ&bssid=AA:BB:CC:DD:EE:FF"
-// Run deauth + handshake capture, then show “Download” link
-static esp_err_t attack_get_handler(httpd_req_t* req)
+// URI: "/download[?id=N][&format=22000]"
+// Serve a capture as attachment (Content-Length, Range resume): the pcap by
+// default, or only its hashcat 22000 lines, a few hundred bytes per handshake
+static esp_err_t download_get_handler(httpd_req_t* req)
 {
-    if (check_and_clean(req)) {
-        return ESP_OK;
+    char format[8];
+    capture_entry_t cap;
+    if (!handshake_capture_find(capture_query(req, format, sizeof(format)), &cap)) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No such capture");
+        return ESP_FAIL;
     }
 
-    char ssid[33] = {0}, chan_str[8] = {0}, bssid_str[18] = {0};
-    char buf[128];
-    httpd_req_get_url_query_str(req, buf, sizeof(buf));
-    httpd_query_key_value(buf, "ssid", ssid, sizeof(ssid));
-    httpd_query_key_value(buf, "chan", chan_str, sizeof(chan_str));
-    httpd_query_key_value(buf, "bssid", bssid_str, sizeof(bssid_str));
-
-    if (strlen(ssid) == 0 || strlen(chan_str) == 0 || strlen(bssid_str) != 17) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad parameters");
-        return ESP_FAIL;
+    char name[40];
+    handshake_capture_name(&cap, name, sizeof(name));
+    if (strcmp(format, "22000") == 0) {
+        if (cap.hc22000_size == 0) {
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No crackable handshake or PMKID captured");
+            return ESP_FAIL;
+        }
+        char path[32];
+        handshake_capture_hc22000_path(cap.id, path, sizeof(path));
+        strcpy(strrchr(name, '.'), ".22000");
+        esp_err_t ret = http_send_file(req, path, "text/plain", name);
+        return ret == ESP_OK ? ESP_OK : ESP_FAIL;
     }
 
-    int channel = atoi(chan_str);
-    if (channel < 1 || channel > 13) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid channel");
-        return ESP_FAIL;
+    // The last capture is usually still complete in the RAM arena: skip the flash read
+    const char* type = cap.pcapng ? HANDSHAKE_PCAPNG_CONTENT_TYPE : HANDSHAKE_PCAP_CONTENT_TYPE;
+    const uint8_t* image;
+    size_t image_len;
+    esp_err_t ret;
+    if (handshake_capture_acquire_ram(cap.id, &image, &image_len)) {
+        ret = http_send_buffer(req, image, image_len, type, name);
+        handshake_capture_release_ram();
+    } else if (handshake_capture_store()) {
+        ret = http_send_record(req, handshake_capture_store(), cap.id, type, name);
+    } else {
+        ret = http_send_file(req, HANDSHAKE_PCAP_PATH, type, name);
     }
+    return ret == ESP_OK ? ESP_OK : ESP_FAIL;
+}
 
-    // Convert BSSID string "AA:BB:CC:DD:EE:FF" → byte[6]
-    uint8_t bssid[6];
-    int vals[6];
-    if (sscanf(bssid_str, "%x:%x:%x:%x:%x:%x",
-               &vals[0], &vals[1], &vals[2],
-               &vals[3], &vals[4], &vals[5]) != 6) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad BSSID");
-        return ESP_FAIL;
+// ──────────────────────────────────────────────────────────────────────────────
+// URI: "/live?chan=N[&bssid=AA:BB:CC:DD:EE:FF][&seconds=N][&profile=NAME]"
+// The handler only queues a live job and returns; the capture writer then sends
+// the response on this socket itself, so httpd keeps serving other clients.
+
+#define LIVE_DEFAULT_S  300
+#define LIVE_MAX_S      3600
+
+typedef struct {
+    httpd_handle_t hd;
+    int            fd;
+    bool           started;   // response headers sent
+    atomic_bool    open;      // cleared when httpd closes the session
+    atomic_int     refs;      // live job + session; free for the next stream at 0
+} live_client_t;
+
+static live_client_t s_live;
+
+static void live_unref(live_client_t* c)
+{
+    atomic_fetch_sub(&c->refs, 1);
+}
+
+static bool live_send(live_client_t* c, const char* p, size_t len)
+{
+    while (len > 0) {
+        if (!atomic_load(&c->open)) {
+            return false;
+        }
+        int n = httpd_socket_send(c->hd, c->fd, p, len, 0);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
     }
-    for (int i = 0; i < 6; i++) {
-        bssid[i] = (uint8_t) vals[i];
+    return true;
+}
+
+// Sink write, from the capture writer task; a slow client stalls it, never the RX path
+static bool live_write(void* ctx, const void* data, size_t len)
+{
+    live_client_t* c = ctx;
+    if (!c->started) {
+        c->started = true;
+        char hdr[192];
+        int n = snprintf(hdr, sizeof(hdr),
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Disposition: inline; filename=live.%s\r\n"
+            "Cache-Control: no-store\r\n"
+            "Connection: close\r\n\r\n",
+#ifdef CONFIG_CAPTURE_FORMAT_PCAPNG
+            HANDSHAKE_PCAPNG_CONTENT_TYPE, "pcapng");
+#else
+            HANDSHAKE_PCAP_CONTENT_TYPE, "pcap");
+#endif
+        if (!live_send(c, hdr, n)) {
+            return false;
+        }
     }
+    return live_send(c, data, len);
+}
 
-    // Run deauth + capture for 20 s (20000 ms)
-    esp_err_t ret = handshake_deauth_and_capture(bssid, (uint8_t)channel, 20000);
-    if (ret != ESP_OK) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Capture failed");
-        return ESP_FAIL;
+static void live_close(void* ctx)
+{
+    live_client_t* c = ctx;
+    if (!c->started) {
+        // The job failed before producing anything
+        static const char resp[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n"
+                                   "Connection: close\r\n\r\n";
+        live_send(c, resp, sizeof(resp) - 1);
+    }
+    if (atomic_load(&c->open)) {
+        httpd_sess_trigger_close(c->hd, c->fd);
     }
+    live_unref(c);
+}
 
-    // Now handshake.pcap exists → show Download link
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_sendstr_chunk(req,
-        "<!DOCTYPE html><html><head><meta charset=\"UTF-8\"><title>Done</title></head><body>"
-        "<h2>Handshake captured!</h2>"
-        "<a href=\"/download\">Download handshake.pcap</a><br>"
-        "<a href=\"/scan\">Attack another</a>"
-        "</body></html>");
-    httpd_resp_sendstr_chunk(req, NULL);
-    return ESP_OK;
+// Session free_ctx: httpd calls it when the connection goes away, whoever closed it
+static void live_session_closed(void* ctx)
+{
+    live_client_t* c = ctx;
+    atomic_store(&c->open, false);
+    live_unref(c);
 }
 
-// ──────────────────────────────────────────────────────────────────────────────
-// URI: "/download"
-// Serve "/spiffs/handshake.pcap" as attachment
-static esp_err_t download_get_handler(httpd_req_t* req)
+static esp_err_t live_get_handler(httpd_req_t* req)
 {
-    if (!handshake_exists()) {
-        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No handshake to download");
+    char query[96] = {0}, val[20];
+    httpd_req_get_url_query_str(req, query, sizeof(query));
+
+    uint8_t bssid[6] = {0};
+    if (httpd_query_key_value(query, "bssid", val, sizeof(val)) == ESP_OK) {
+        unsigned b[6];
+        if (sscanf(val, "%2x:%2x:%2x:%2x:%2x:%2x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad bssid");
+            return ESP_FAIL;
+        }
+        for (int i = 0; i < 6; i++) {
+            bssid[i] = (uint8_t)b[i];
+        }
+    }
+    uint32_t channel = httpd_query_key_value(query, "chan", val, sizeof(val)) == ESP_OK
+                       ? strtoul(val, NULL, 10) : 0;
+    if (channel < 1 || channel > 13) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing or bad chan");
         return ESP_FAIL;
     }
-
-    int fd = open("/spiffs/handshake.pcap", O_RDONLY);
-    if (fd < 0) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Cannot open file");
+    uint32_t seconds = httpd_query_key_value(query, "seconds", val, sizeof(val)) == ESP_OK
+                       ? strtoul(val, NULL, 10) : LIVE_DEFAULT_S;
+    if (seconds == 0 || seconds > LIVE_MAX_S) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad seconds");
+        return ESP_FAIL;
+    }
+    capture_profile_t profile = CAPTURE_PROFILE_DEFAULT;
+    if (httpd_query_key_value(query, "profile", val, sizeof(val)) == ESP_OK &&
+        !handshake_capture_profile_parse(val, &profile)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad profile");
         return ESP_FAIL;
     }
 
-    httpd_resp_set_type(req, "application/octet-stream");
-    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=handshake.pcap");
-
-    char buf[1024];
-    ssize_t r;
-    while ((r = read(fd, buf, sizeof(buf))) > 0) {
-        httpd_resp_send_chunk(req, buf, r);
+    // One stream at a time: the context is shared with the job and the session
+    int idle = 0;
+    if (!atomic_compare_exchange_strong(&s_live.refs, &idle, 2)) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Live stream already running");
+        return ESP_OK;
+    }
+    s_live.hd = req->handle;
+    s_live.fd = httpd_req_to_sockfd(req);
+    s_live.started = false;
+    atomic_store(&s_live.open, true);
+
+    const pcap_writer_sink_t sink = { .write = live_write, .close = live_close, .ctx = &s_live };
+    uint32_t id;
+    if (capture_job_submit_live(bssid, (uint8_t)channel, seconds * 1000, profile, &sink, &id) != ESP_OK) {
+        atomic_store(&s_live.refs, 0);
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Capture queue full");
+        return ESP_OK;
     }
-    close(fd);
-    httpd_resp_send_chunk(req, NULL, 0);
+    ESP_LOGI(TAG, "Live stream queued as job %u", (unsigned)id);
+    req->sess_ctx = &s_live;
+    req->free_ctx = live_session_closed;
     return ESP_OK;
 }
@@ -0,0 +1,164 @@
+/**
+ * json_writer.c
+ */
+
+#include "json_writer.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static void flush_buf(json_writer_t* w)
+{
+    if (w->len > 0 && w->err == ESP_OK) {
+        w->err = w->flush(w->ctx, w->buf, w->len);
+    }
+    w->len = 0;
+}
+
+static void put(json_writer_t* w, const char* s, size_t n)
+{
+    while (n > 0) {
+        if (w->len == w->cap) {
+            flush_buf(w);
+        }
+        size_t room = w->cap - w->len;
+        size_t k = n < room ? n : room;
+        memcpy(w->buf + w->len, s, k);
+        w->len += k;
+        s += k;
+        n -= k;
+    }
+}
+
+static inline void putc_(json_writer_t* w, char c)
+{
+    put(w, &c, 1);
+}
+
+// Emit the separator owed before a new value at the current depth
+static void begin_value(json_writer_t* w)
+{
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->need_comma[w->depth]) {
+        putc_(w, ',');
+    }
+    w->need_comma[w->depth] = true;
+}
+
+void json_init(json_writer_t* w, char* buf, size_t cap, json_flush_fn flush, void* ctx)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->cap = cap;
+    w->flush = flush;
+    w->ctx = ctx;
+    w->err = ESP_OK;
+}
+
+static void open_scope(json_writer_t* w, char c)
+{
+    begin_value(w);
+    putc_(w, c);
+    if (w->depth < JSON_MAX_DEPTH) {
+        w->depth++;
+        w->need_comma[w->depth] = false;
+    } else if (w->err == ESP_OK) {
+        w->err = ESP_ERR_INVALID_STATE;
+    }
+}
+
+static void close_scope(json_writer_t* w, char c)
+{
+    putc_(w, c);
+    if (w->depth > 0) {
+        w->depth--;
+    }
+}
+
+void json_obj_begin(json_writer_t* w) { open_scope(w, '{'); }
+void json_obj_end(json_writer_t* w)   { close_scope(w, '}'); }
+void json_arr_begin(json_writer_t* w) { open_scope(w, '['); }
+void json_arr_end(json_writer_t* w)   { close_scope(w, ']'); }
+
+static void put_escaped(json_writer_t* w, const char* s, size_t len)
+{
+    putc_(w, '"');
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            char esc[2] = { '\\', (char)c };
+            put(w, esc, 2);
+        } else if (c < 0x20) {
+            char esc[8];
+            int n = snprintf(esc, sizeof(esc), "\\u%04x", c);
+            put(w, esc, n);
+        } else {
+            putc_(w, (char)c);
+        }
+    }
+    putc_(w, '"');
+}
+
+void json_key(json_writer_t* w, const char* key)
+{
+    begin_value(w);
+    put_escaped(w, key, strlen(key));
+    putc_(w, ':');
+    w->after_key = true;
+}
+
+void json_strn(json_writer_t* w, const char* s, size_t len)
+{
+    begin_value(w);
+    put_escaped(w, s, len);
+}
+
+void json_str(json_writer_t* w, const char* s)
+{
+    json_strn(w, s, strlen(s));
+}
+
+void json_int(json_writer_t* w, int64_t v)
+{
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%" PRId64, v);
+    begin_value(w);
+    put(w, num, n);
+}
+
+void json_uint(json_writer_t* w, uint64_t v)
+{
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%" PRIu64, v);
+    begin_value(w);
+    put(w, num, n);
+}
+
+void json_bool(json_writer_t* w, bool v)
+{
+    begin_value(w);
+    put(w, v ? "true" : "false", v ? 4 : 5);
+}
+
+void json_mac(json_writer_t* w, const uint8_t mac[6])
+{
+    char s[18];
+    snprintf(s, sizeof(s), "%02x:%02x:%02x:%02x:%02x:%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    json_strn(w, s, 17);
+}
+
+void json_newline(json_writer_t* w)
+{
+    putc_(w, '\n');
+    w->need_comma[w->depth] = false;
+}
+
+esp_err_t json_finish(json_writer_t* w)
+{
+    flush_buf(w);
+    return w->err;
+}
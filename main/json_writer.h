@@ -0,0 +1,62 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Streaming JSON serializer without heap allocation.
+ *
+ * Output accumulates in a caller-supplied buffer and is handed to a flush
+ * callback whenever it fills, so arbitrarily long documents can be produced
+ * from a few hundred bytes of stack. Commas and nesting are tracked for the
+ * caller; the first error is sticky and reported by json_finish().
+ */
+
+#define JSON_MAX_DEPTH  8
+
+typedef esp_err_t (*json_flush_fn)(void* ctx, const char* data, size_t len);
+
+typedef struct {
+    char*         buf;
+    size_t        cap;
+    size_t        len;
+    json_flush_fn flush;
+    void*         ctx;
+    uint8_t       depth;
+    bool          after_key;
+    bool          need_comma[JSON_MAX_DEPTH + 1];
+    esp_err_t     err;
+} json_writer_t;
+
+void json_init(json_writer_t* w, char* buf, size_t cap, json_flush_fn flush, void* ctx);
+
+void json_obj_begin(json_writer_t* w);
+void json_obj_end(json_writer_t* w);
+void json_arr_begin(json_writer_t* w);
+void json_arr_end(json_writer_t* w);
+
+void json_key(json_writer_t* w, const char* key);
+void json_str(json_writer_t* w, const char* s);
+void json_strn(json_writer_t* w, const char* s, size_t len);
+void json_int(json_writer_t* w, int64_t v);
+void json_uint(json_writer_t* w, uint64_t v);
+void json_bool(json_writer_t* w, bool v);
+void json_mac(json_writer_t* w, const uint8_t mac[6]);
+
+static inline void json_kv_str(json_writer_t* w, const char* k, const char* v)  { json_key(w, k); json_str(w, v); }
+static inline void json_kv_int(json_writer_t* w, const char* k, int64_t v)      { json_key(w, k); json_int(w, v); }
+static inline void json_kv_uint(json_writer_t* w, const char* k, uint64_t v)    { json_key(w, k); json_uint(w, v); }
+static inline void json_kv_bool(json_writer_t* w, const char* k, bool v)        { json_key(w, k); json_bool(w, v); }
+static inline void json_kv_mac(json_writer_t* w, const char* k, const uint8_t* v) { json_key(w, k); json_mac(w, v); }
+
+/**
+ * @brief End a top-level value with a newline (NDJSON); the next value starts a new record.
+ */
+void json_newline(json_writer_t* w);
+
+/**
+ * @brief Flush whatever is buffered.
+ * @return The first error seen while writing, or ESP_OK.
+ */
+esp_err_t json_finish(json_writer_t* w);
@@ -0,0 +1,296 @@
+/**
+ * scan_cache.c
+ *
+ * AP / client table. Frames reach it from the capture path or from the
+ * passive listener below; active scans (refresh task, scan_cache_refresh,
+ * scan_cache_sweep) merge into it too and are skipped while a capture job
+ * owns the radio. The passive listener is paused around active scans.
+ */
+
+#include "scan_cache.h"
+#include "bss_table.h"
+#include "wifi_station.h"
+#include "capture_job.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char* TAG = "scan_cache";
+
+#define SCAN_TASK_STACK  4096
+#define SCAN_TASK_PRIO   3
+#define MAX_AGE_US       ((int64_t)CONFIG_SCAN_CACHE_MAX_AGE_S * 1000000)
+#define FCS_LEN          4
+
+static bss_table_t s_table;
+static int64_t s_last_scan_us = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_scan_mutex = NULL;   // one driver scan at a time; guards s_listen
+static bool s_listen = false;                   // passive listener wanted (capture job idle)
+
+// bss_auth_t → driver auth mode; BSS_AUTH_UNKNOWN entries are never reported
+static const wifi_auth_mode_t s_auth_mode[] = {
+    [BSS_AUTH_UNKNOWN]         = WIFI_AUTH_OPEN,
+    [BSS_AUTH_OPEN]            = WIFI_AUTH_OPEN,
+    [BSS_AUTH_WEP]             = WIFI_AUTH_WEP,
+    [BSS_AUTH_WPA]             = WIFI_AUTH_WPA_PSK,
+    [BSS_AUTH_WPA2]            = WIFI_AUTH_WPA2_PSK,
+    [BSS_AUTH_WPA_WPA2]        = WIFI_AUTH_WPA_WPA2_PSK,
+    [BSS_AUTH_WPA2_ENTERPRISE] = WIFI_AUTH_WPA2_ENTERPRISE,
+    [BSS_AUTH_WPA3]            = WIFI_AUTH_WPA3_PSK,
+    [BSS_AUTH_WPA2_WPA3]       = WIFI_AUTH_WPA2_WPA3_PSK,
+};
+
+static bss_auth_t bss_auth(wifi_auth_mode_t mode)
+{
+    for (size_t i = BSS_AUTH_OPEN; i < sizeof(s_auth_mode) / sizeof(s_auth_mode[0]); i++) {
+        if (s_auth_mode[i] == mode) {
+            return (bss_auth_t)i;
+        }
+    }
+    return BSS_AUTH_WPA2;   // OWE, WAPI, ...: close enough for the attack page
+}
+
+void scan_cache_observe(const uint8_t* frame, uint32_t len, int8_t rssi, uint8_t channel)
+{
+    if (!s_table.bss) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    bss_table_observe(&s_table, frame, len, rssi, channel, now);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+#ifdef CONFIG_SCAN_PASSIVE
+static void passive_cb(void* buf, wifi_promiscuous_pkt_type_t type)
+{
+    if (type != WIFI_PKT_MGMT && type != WIFI_PKT_DATA) {
+        return;
+    }
+    const wifi_promiscuous_pkt_t* pkt = buf;
+    uint32_t len = pkt->rx_ctrl.sig_len;
+    if (len > FCS_LEN) {
+        scan_cache_observe(pkt->payload, len - FCS_LEN, pkt->rx_ctrl.rssi, pkt->rx_ctrl.channel);
+    }
+}
+#endif
+
+// Apply the listener state; s_scan_mutex held
+static void listen_apply(bool on)
+{
+#ifdef CONFIG_SCAN_PASSIVE
+    if (on) {
+        const wifi_promiscuous_filter_t filter = {
+            .filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_DATA,
+        };
+        esp_wifi_set_promiscuous_filter(&filter);
+        esp_wifi_set_promiscuous_rx_cb(passive_cb);
+    }
+    // Promiscuous RX rides along with the STA link on its current channel
+    esp_err_t err = esp_wifi_set_promiscuous(on);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Passive listener %s failed (%s)", on ? "start" : "stop", esp_err_to_name(err));
+    }
+#endif
+}
+
+void scan_cache_listen(bool on)
+{
+    if (!s_scan_mutex) {
+        return;
+    }
+    xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+    s_listen = on;
+    listen_apply(on);
+    xSemaphoreGive(s_scan_mutex);
+}
+
+void scan_cache_merge(const wifi_ap_record_t* records, uint16_t count)
+{
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&s_lock);
+    for (uint16_t i = 0; i < count; i++) {
+        const wifi_ap_record_t* ap = &records[i];
+        bss_table_add(&s_table, ap->bssid, ap->ssid, strnlen((const char*)ap->ssid, sizeof(ap->ssid)),
+                      ap->primary, ap->rssi, bss_auth(ap->authmode), now);
+    }
+    s_last_scan_us = now;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t scan_cache_refresh(void)
+{
+    if (capture_job_busy()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+    if (s_listen) {
+        listen_apply(false);
+    }
+
+    wifi_ap_list_t aps;
+    esp_err_t ret = wifi_scan_once(&aps);
+    if (ret == ESP_OK) {
+        scan_cache_merge(aps.rec, aps.count);
+        ESP_LOGI(TAG, "Scan found %u APs (kept %u)", aps.found, aps.count);
+    } else {
+        ESP_LOGW(TAG, "Scan failed (%s)", esp_err_to_name(ret));
+    }
+
+    if (s_listen) {
+        listen_apply(true);
+    }
+    xSemaphoreGive(s_scan_mutex);
+    return ret;
+}
+
+esp_err_t scan_cache_sweep(scan_channel_cb_t cb, void* ctx)
+{
+    if (capture_job_busy()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+    if (s_listen) {
+        listen_apply(false);
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (uint8_t ch = 1; ch <= WIFI_SCAN_MAX_CHANNEL && ret == ESP_OK; ch++) {
+        wifi_ap_list_t aps;   // the station's pool, guarded by s_scan_mutex
+        if (wifi_scan_channel(ch, &aps) != ESP_OK) {
+            ESP_LOGW(TAG, "Channel %u scan failed", ch);
+        }
+        scan_cache_merge(aps.rec, aps.count);
+        ret = cb(ch, aps.rec, aps.count, ctx);
+    }
+
+    if (s_listen) {
+        listen_apply(true);
+    }
+    xSemaphoreGive(s_scan_mutex);
+    return ret;
+}
+
+static int8_t rssi_dbm(int16_t rssi_x16)
+{
+    return (int8_t)((rssi_x16 - 8) / 16);   // round to nearest for negative values
+}
+
+size_t scan_cache_snapshot(scan_entry_t* out, size_t max, int64_t* scan_us)
+{
+    size_t n = 0;
+    taskENTER_CRITICAL(&s_lock);
+    bss_table_expire(&s_table, esp_timer_get_time() - MAX_AGE_US);
+    for (uint32_t i = 0; i <= s_table.bss_mask && n < max; i++) {
+        const bss_entry_t* e = &s_table.bss[i];
+        // Only data frames so far: no ESSID or security to show
+        if (!e->used || e->auth == BSS_AUTH_UNKNOWN) {
+            continue;
+        }
+        scan_entry_t* ap = &out[n++];
+        memcpy(ap->bssid, e->bssid, 6);
+        memcpy(ap->ssid, e->ssid, e->ssid_len);
+        ap->ssid[e->ssid_len] = 0;
+        ap->channel = e->channel;
+        ap->rssi = rssi_dbm(e->rssi_x16);
+        ap->authmode = s_auth_mode[e->auth];
+        ap->last_seen_us = e->last_seen_us;
+        ap->frames = e->frames;
+        ap->beacons = e->beacons;
+    }
+    if (scan_us) {
+        *scan_us = s_last_scan_us;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    // One short critical section per AP rather than a long one for all of them
+    for (size_t i = 0; i < n; i++) {
+        taskENTER_CRITICAL(&s_lock);
+        out[i].stations = bss_table_station_count(&s_table, out[i].bssid);
+        taskEXIT_CRITICAL(&s_lock);
+    }
+
+    // Strongest first; the table is small, insertion sort is plenty
+    for (size_t i = 1; i < n; i++) {
+        scan_entry_t tmp = out[i];
+        size_t j = i;
+        while (j > 0 && out[j - 1].rssi < tmp.rssi) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = tmp;
+    }
+    return n;
+}
+
+size_t scan_cache_stations(scan_station_t* out, size_t max)
+{
+    size_t n = 0;
+    taskENTER_CRITICAL(&s_lock);
+    bss_table_expire(&s_table, esp_timer_get_time() - MAX_AGE_US);
+    for (uint32_t i = 0; i <= s_table.sta_mask && n < max; i++) {
+        const bss_station_t* e = &s_table.sta[i];
+        if (!e->used) {
+            continue;
+        }
+        scan_station_t* sta = &out[n++];
+        memcpy(sta->mac, e->mac, 6);
+        memcpy(sta->bssid, e->bssid, 6);
+        sta->rssi = e->rssi_x16 ? rssi_dbm(e->rssi_x16) : 0;
+        sta->frames = e->frames;
+        sta->last_seen_us = e->last_seen_us;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    for (size_t i = 1; i < n; i++) {
+        scan_station_t tmp = out[i];
+        size_t j = i;
+        while (j > 0 && out[j - 1].last_seen_us < tmp.last_seen_us) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = tmp;
+    }
+    return n;
+}
+
+#if CONFIG_SCAN_CACHE_REFRESH_S > 0
+static void scan_task(void* arg)
+{
+    // An all-channel scan before association would have to stop the join
+    wifi_wait_connected(WIFI_WAIT_FOREVER);
+    for (;;) {
+        scan_cache_refresh();
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_SCAN_CACHE_REFRESH_S * 1000));
+    }
+}
+#endif
+
+esp_err_t scan_cache_init(void)
+{
+    bss_entry_t* bss = calloc(bss_table_slots(SCAN_CACHE_MAX_APS), sizeof(bss_entry_t));
+    bss_station_t* sta = calloc(bss_table_slots(SCAN_CACHE_MAX_STATIONS), sizeof(bss_station_t));
+    s_scan_mutex = xSemaphoreCreateMutex();
+    if (!bss || !sta || !s_scan_mutex) {
+        free(bss);
+        free(sta);
+        return ESP_ERR_NO_MEM;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    bss_table_init(&s_table, bss, SCAN_CACHE_MAX_APS, sta, SCAN_CACHE_MAX_STATIONS);
+    taskEXIT_CRITICAL(&s_lock);
+    // A job queued before init (boot benchmark) never owns the radio, so start listening now
+    scan_cache_listen(true);
+#if CONFIG_SCAN_CACHE_REFRESH_S > 0
+    if (xTaskCreate(scan_task, "scan_cache", SCAN_TASK_STACK, NULL, SCAN_TASK_PRIO, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
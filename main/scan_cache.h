@@ -0,0 +1,94 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_wifi.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * AP and client table served by /scan and /api/scan without touching the radio.
+ *
+ * The table (bss_table) is fed from every promiscuous frame: by the capture
+ * path while a job runs, and otherwise by a passive listener on the station's
+ * own channel (CONFIG_SCAN_PASSIVE), so the STA link is never torn down just
+ * to render a page. Active scans, on demand or from the optional background
+ * task, merge into the same table. Entries not seen for
+ * CONFIG_SCAN_CACHE_MAX_AGE_S are dropped.
+ */
+
+typedef struct {
+    uint8_t          bssid[6];
+    char             ssid[33];
+    uint8_t          channel;
+    int8_t           rssi;
+    wifi_auth_mode_t authmode;
+    int64_t          last_seen_us;   // esp_timer time of the last frame or scan that saw it
+    uint32_t         frames;         // frames heard to or from the BSS
+    uint32_t         beacons;        // beacons and probe responses among them
+    uint16_t         stations;       // clients currently attributed to it
+} scan_entry_t;
+
+typedef struct {
+    uint8_t  mac[6];
+    uint8_t  bssid[6];
+    int8_t   rssi;                   // 0 until the client itself has been heard
+    uint32_t frames;
+    int64_t  last_seen_us;
+} scan_station_t;
+
+#define SCAN_CACHE_MAX_APS       CONFIG_SCAN_CACHE_MAX_APS
+#define SCAN_CACHE_MAX_STATIONS  CONFIG_SCAN_CACHE_MAX_STATIONS
+
+/**
+ * @brief Allocate the table, start passive listening and the background refresh task.
+ */
+esp_err_t scan_cache_init(void);
+
+/**
+ * @brief Feed one received frame (raw MPDU, no FCS) into the table. Safe from the RX callback.
+ */
+void scan_cache_observe(const uint8_t* frame, uint32_t len, int8_t rssi, uint8_t channel);
+
+/**
+ * @brief Allow or stop the passive listener. The capture job task turns it off
+ *        before a job takes the radio and back on afterwards.
+ */
+void scan_cache_listen(bool on);
+
+/**
+ * @brief Run a scan now and merge its results. Blocks for the scan duration.
+ */
+esp_err_t scan_cache_refresh(void);
+
+/**
+ * @brief Copy the live entries, strongest first.
+ * @param[out] out     Destination array.
+ * @param      max     Capacity of out.
+ * @param[out] scan_us esp_timer time of the last completed scan (0 if none yet); may be NULL.
+ * @return Number of entries copied.
+ */
+size_t scan_cache_snapshot(scan_entry_t* out, size_t max, int64_t* scan_us);
+
+/**
+ * @brief Copy the live clients, most recently seen first.
+ * @return Number of entries copied.
+ */
+size_t scan_cache_stations(scan_station_t* out, size_t max);
+
+/**
+ * @brief Merge externally obtained scan records (e.g. a streamed per-channel scan).
+ */
+void scan_cache_merge(const wifi_ap_record_t* records, uint16_t count);
+
+/**
+ * @brief Called by scan_cache_sweep() after each channel with that channel's APs.
+ * @return ESP_OK to continue, anything else aborts the sweep (e.g. client gone).
+ */
+typedef esp_err_t (*scan_channel_cb_t)(uint8_t channel, const wifi_ap_record_t* records,
+                                       uint16_t count, void* ctx);
+
+/**
+ * @brief Scan channel by channel, merging and reporting each channel as it completes.
+ *        First results are available after one channel dwell instead of a full sweep.
+ */
+esp_err_t scan_cache_sweep(scan_channel_cb_t cb, void* ctx);
@@ -0,0 +1,17 @@
+#!/usr/bin/env python3
+"""Gzip one web UI asset for embedding in the firmware.
+
+The output carries no file name and a zero mtime, so the image (and the
+ETag derived from it) only changes when the asset does.
+
+usage: gzip_asset.py <input> <output.gz>
+"""
+import gzip
+import sys
+
+src, dst = sys.argv[1], sys.argv[2]
+with open(src, 'rb') as f:
+    data = f.read()
+with open(dst, 'wb') as out:
+    with gzip.GzipFile(filename='', mode='wb', compresslevel=9, fileobj=out, mtime=0) as gz:
+        gz.write(data)
@@ -2,8 +2,12 @@
  * wifi_station.c
  *
  * Implements:
- *  - Connecting to Wi-Fi STA (using credentials in sdkconfig)
- *  - One-shot scanning of all nearby APs
+ *  - Connecting to Wi-Fi STA (using credentials in sdkconfig) without blocking
+ *    boot, with the last AP's BSSID and channel kept in NVS so a restart joins
+ *    it directly instead of scanning for it
+ *  - One-shot scanning of all nearby APs, connected (no reassociation) while associated
+ *  - Non-blocking single-channel scans completed via WIFI_EVENT_SCAN_DONE
+ *  - The fixed, RSSI-sorted record pool both scans fill
  */
 
 #include "wifi_station.h"
@@ -11,9 +15,11 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include <string.h>
-#include <stdlib.h>
 
 static const char* TAG = "wifi_sta";
 
@@ -21,15 +27,91 @@ static const char* TAG = "wifi_sta";
 static bool s_connected = false;
 static char s_ip_str[16] = { 0 };
 
+static EventGroupHandle_t s_wifi_events = NULL;
+#define SCAN_DONE_BIT BIT0
+#define GOT_IP_BIT    BIT1
+
+#define UNASSOCIATED_DWELL_MS  120   // per channel, the driver's default active scan time
+
+// Where the last association went, kept in NVS for the next boot
+#define AP_HINT_NS   "wifi_sta"
+#define AP_HINT_KEY  "ap_hint"
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+} ap_hint_t;
+
+static wifi_config_t s_sta_config;
+static ap_hint_t     s_hint;          // as stored in NVS, channel 0 = none
+static bool          s_hint_pending;  // s_sta_config is pinned to s_hint and has not connected yet
+static volatile bool s_scanning;      // unassociated scan in flight: hold off reconnecting
+
+static wifi_ap_record_t s_ap_pool[CONFIG_WIFI_AP_POOL_SIZE];
+
+static void ap_hint_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(AP_HINT_NS, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    size_t len = sizeof(s_hint);
+    if (nvs_get_blob(nvs, AP_HINT_KEY, &s_hint, &len) != ESP_OK || len != sizeof(s_hint) ||
+        s_hint.channel < 1 || s_hint.channel > WIFI_SCAN_MAX_CHANNEL) {
+        memset(&s_hint, 0, sizeof(s_hint));
+    }
+    nvs_close(nvs);
+}
+
+/**
+ * @brief Remember the AP we associated with; only writes flash when it changed.
+ */
+static void ap_hint_save(const uint8_t bssid[6], uint8_t channel)
+{
+    if (s_hint.channel == channel && memcmp(s_hint.bssid, bssid, 6) == 0) {
+        return;
+    }
+    memcpy(s_hint.bssid, bssid, 6);
+    s_hint.channel = channel;
+    nvs_handle_t nvs;
+    if (nvs_open(AP_HINT_NS, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(nvs, AP_HINT_KEY, &s_hint, sizeof(s_hint)) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
 static void on_wifi_event(void* arg, esp_event_base_t event_base,
                           int32_t event_id, void* event_data)
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        xEventGroupSetBits(s_wifi_events, SCAN_DONE_BIT);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        const wifi_event_sta_connected_t* ev = event_data;
+        s_hint_pending = false;
+        ap_hint_save(ev->bssid, ev->channel);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGI(TAG, "Disconnected, retrying...");
-        esp_wifi_connect();
+        xEventGroupClearBits(s_wifi_events, GOT_IP_BIT);
         s_connected = false;
+        if (s_scanning) {
+            // Our own disconnect ahead of a scan (or a failure during it): a connect
+            // attempt now would make the scan fail, so wifi_scan_once reconnects after
+            return;
+        }
+        if (s_hint_pending) {
+            // The remembered AP did not take us: look for the SSID on every channel
+            ESP_LOGI(TAG, "Stored AP not reachable, scanning for %s", CONFIG_WIFI_SSID);
+            s_hint_pending = false;
+            s_sta_config.sta.bssid_set = false;
+            s_sta_config.sta.channel = 0;
+            esp_wifi_set_config(WIFI_IF_STA, &s_sta_config);
+        } else {
+            ESP_LOGI(TAG, "Disconnected, retrying...");
+        }
+        esp_wifi_connect();
     }
 }
 
@@ -42,9 +124,10 @@ static void on_ip_event(void* arg, esp_event_base_t event_base,
              IP2STR(&ip_info->ip));
     ESP_LOGI(TAG, "Got IP: %s", s_ip_str);
     s_connected = true;
+    xEventGroupSetBits(s_wifi_events, GOT_IP_BIT);
 }
 
-esp_err_t wifi_init_sta(void)
+esp_err_t wifi_start_sta(void)
 {
     // 1) Init NVS (needed by Wi-Fi)
     esp_err_t ret = nvs_flash_init();
@@ -53,6 +136,7 @@ esp_err_t wifi_init_sta(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    ap_hint_load();
 
     // 2) Init TCP/IP stack and event loop
     ESP_ERROR_CHECK(esp_netif_init());
@@ -66,12 +150,14 @@ esp_err_t wifi_init_sta(void)
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
     // 4) Register event handlers
+    s_wifi_events = xEventGroupCreate();
+    assert(s_wifi_events);
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         WIFI_EVENT, ESP_EVENT_ANY_ID, &on_wifi_event, NULL, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         IP_EVENT, IP_EVENT_STA_GOT_IP, &on_ip_event, NULL, NULL));
 
-    // 5) Configure STA with SSID/PASS from sdkconfig
+    // 5) Configure STA with SSID/PASS from sdkconfig, pinned to the last AP if we know it
     wifi_config_t wifi_config = {
         .sta = {
             .ssid = CONFIG_WIFI_SSID,
@@ -79,54 +165,149 @@ esp_err_t wifi_init_sta(void)
             .threshold.authmode = WIFI_AUTH_WPA2_PSK,
         },
     };
+    s_sta_config = wifi_config;
+    if (s_hint.channel) {
+        memcpy(s_sta_config.sta.bssid, s_hint.bssid, 6);
+        s_sta_config.sta.bssid_set = true;
+        s_sta_config.sta.channel = s_hint.channel;
+        s_hint_pending = true;
+        ESP_LOGI(TAG, "Rejoining %02x:%02x:%02x:%02x:%02x:%02x on channel %u",
+                 s_hint.bssid[0], s_hint.bssid[1], s_hint.bssid[2],
+                 s_hint.bssid[3], s_hint.bssid[4], s_hint.bssid[5], s_hint.channel);
+    }
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_sta_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
     ESP_LOGI(TAG, "Connecting to Wi-Fi SSID: %s …", CONFIG_WIFI_SSID);
-
-    // 6) Wait until connected or timeout (~15 seconds)
-    uint32_t retry = 0;
-    while (!s_connected && retry++ < 150) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-    if (!s_connected) {
-        ESP_LOGE(TAG, "Failed to connect to %s", CONFIG_WIFI_SSID);
-        return ESP_ERR_TIMEOUT;
-    }
-
-    ESP_LOGI(TAG, "Connected! IP: %s", s_ip_str);
     return ESP_OK;
 }
 
+bool wifi_wait_connected(uint32_t timeout_ms)
+{
+    TickType_t ticks = timeout_ms == WIFI_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return xEventGroupWaitBits(s_wifi_events, GOT_IP_BIT, pdFALSE, pdFALSE, ticks) & GOT_IP_BIT;
+}
+
 const char* wifi_get_ip_str(void)
 {
     return s_ip_str;
 }
 
-esp_err_t wifi_scan_once(uint16_t* out_count, wifi_ap_record_t** out_info)
+/**
+ * @brief Move the driver's scan results into s_ap_pool, strongest first.
+ *        Pops one record at a time so nothing is allocated here, and always
+ *        leaves the driver's list empty.
+ */
+static void ap_pool_fill(wifi_ap_list_t* out)
+{
+    uint16_t count = 0, found = 0;
+    wifi_ap_record_t rec;
+    while (esp_wifi_scan_get_ap_record(&rec) == ESP_OK) {
+        found++;
+        if (count == CONFIG_WIFI_AP_POOL_SIZE) {
+            if (rec.rssi <= s_ap_pool[count - 1].rssi) {
+                continue;   // weaker than everything kept
+            }
+            count--;        // drop the weakest
+        }
+        uint16_t pos = count;
+        while (pos > 0 && s_ap_pool[pos - 1].rssi < rec.rssi) {
+            pos--;
+        }
+        memmove(&s_ap_pool[pos + 1], &s_ap_pool[pos], (count - pos) * sizeof(rec));
+        s_ap_pool[pos] = rec;
+        count++;
+    }
+    esp_wifi_clear_ap_list();
+
+    out->rec = s_ap_pool;
+    out->count = count;
+    out->found = found;
+    if (found > count) {
+        ESP_LOGD(TAG, "Scan pool full: kept %u strongest of %u APs", count, found);
+    }
+}
+
+/**
+ * @brief Start a non-blocking scan, wait for WIFI_EVENT_SCAN_DONE and collect the results.
+ */
+static esp_err_t scan_run(const wifi_scan_config_t* cfg, uint32_t timeout_ms, wifi_ap_list_t* out)
+{
+    out->rec = s_ap_pool;
+    out->count = out->found = 0;
+
+    xEventGroupClearBits(s_wifi_events, SCAN_DONE_BIT);
+    esp_err_t ret = esp_wifi_scan_start(cfg, false);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_events, SCAN_DONE_BIT, pdTRUE, pdFALSE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    if (!(bits & SCAN_DONE_BIT)) {
+        esp_wifi_scan_stop();
+        esp_wifi_clear_ap_list();
+        return ESP_ERR_TIMEOUT;
+    }
+    ap_pool_fill(out);
+    return ESP_OK;
+}
+
+esp_err_t wifi_scan_once(wifi_ap_list_t* out)
 {
-    // Ensure Wi-Fi is in STA mode
-    ESP_ERROR_CHECK(esp_wifi_disconnect());
+    if (s_connected) {
+        // Connected scan: stay associated, dwell briefly on each channel and go
+        // back to the AP's channel in between so traffic (and HTTP) keeps flowing
+        wifi_scan_config_t scan_config = {
+            .ssid = 0,
+            .bssid = 0,
+            .channel = 0,        // 0 = all channels
+            .show_hidden = true,
+            .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+            .scan_time.active = {
+                .min = 0,
+                .max = CONFIG_SCAN_CONNECTED_DWELL_MS,
+            },
+            .home_chan_dwell_time = CONFIG_SCAN_HOME_CHAN_DWELL_MS,
+        };
+        uint32_t sweep_ms = WIFI_SCAN_MAX_CHANNEL *
+                            (CONFIG_SCAN_CONNECTED_DWELL_MS + CONFIG_SCAN_HOME_CHAN_DWELL_MS);
+        return scan_run(&scan_config, sweep_ms * 2 + 1000, out);
+    }
+
+    // Not associated (yet): stop the connection attempt in progress, which would
+    // make the scan fail, and keep on_wifi_event from starting another until done
     wifi_scan_config_t scan_config = {
         .ssid = 0,
         .bssid = 0,
         .channel = 0,        // 0 = all channels
-        .show_hidden = true
+        .show_hidden = true,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = {
+            .min = 0,
+            .max = UNASSOCIATED_DWELL_MS,
+        },
     };
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_start());
-
-    // Start scan (blocking)
-    ESP_ERROR_CHECK(esp_wifi_scan_start(&scan_config, true));
+    s_scanning = true;
+    esp_wifi_disconnect();   // fails harmlessly when no attempt is running
+    esp_err_t ret = scan_run(&scan_config, WIFI_SCAN_MAX_CHANNEL * UNASSOCIATED_DWELL_MS * 2 + 1000, out);
+    s_scanning = false;
+    esp_wifi_connect();
+    return ret;
+}
 
-    uint16_t num_ap = 0;
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_num(&num_ap));
-    *out_count = num_ap;
-    *out_info = malloc(sizeof(wifi_ap_record_t) * num_ap);
-    if (*out_info == NULL) {
-        return ESP_ERR_NO_MEM;
-    }
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(out_count, *out_info));
-    return ESP_OK;
+esp_err_t wifi_scan_channel(uint8_t channel, wifi_ap_list_t* out)
+{
+    wifi_scan_config_t scan_config = {
+        .ssid = 0,
+        .bssid = 0,
+        .channel = channel,
+        .show_hidden = true,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = {
+            .min = 0,
+            .max = CONFIG_SCAN_CHANNEL_DWELL_MS,
+        },
+    };
+    return scan_run(&scan_config, CONFIG_SCAN_CHANNEL_DWELL_MS * 4 + 500, out);
 }
@@ -1,12 +1,25 @@
 #pragma once
 #include "esp_err.h"
 #include "esp_wifi.h"
+#include <stdbool.h>
+#include <stdint.h>
 
 /**
- * @brief Initialize Wi-Fi as STA using CONFIG_WIFI_SSID / CONFIG_WIFI_PASSWORD.
- *        Blocks until an IP is obtained or times out.
+ * @brief Initialize Wi-Fi as STA using CONFIG_WIFI_SSID / CONFIG_WIFI_PASSWORD and
+ *        start joining without waiting for it. When NVS holds the BSSID and
+ *        channel of the last association the STA goes straight there, falling
+ *        back to a normal search if that AP does not answer.
  */
-esp_err_t wifi_init_sta(void);
+esp_err_t wifi_start_sta(void);
+
+#define WIFI_WAIT_FOREVER UINT32_MAX
+
+/**
+ * @brief Block until the STA has an IP address (no polling).
+ * @param timeout_ms Longest wait, or WIFI_WAIT_FOREVER.
+ * @return true once connected, false on timeout.
+ */
+bool wifi_wait_connected(uint32_t timeout_ms);
 
 /**
  * @brief Return the IP address assigned to ESP32 in STA mode as a C string.
@@ -15,8 +28,37 @@ esp_err_t wifi_init_sta(void);
 const char* wifi_get_ip_str(void);
 
 /**
- * @brief Perform a one-shot scan of nearby APs.
- * @param[out] out_count  Number of APs found.
- * @param[out] out_info   Dynamically malloc’d array of wifi_ap_record_t. Caller must free().
+ * Scan results live in one fixed pool of CONFIG_WIFI_AP_POOL_SIZE records owned
+ * by wifi_station.c, so scanning never allocates. The driver's list is drained
+ * record by record into it, kept sorted by RSSI (strongest first); when more APs
+ * answer than the pool holds, the weakest are dropped and counted in `found`.
+ * The list stays valid until the next scan; callers serialise scans.
+ */
+typedef struct {
+    const wifi_ap_record_t* rec;
+    uint16_t count;   // records held, strongest first
+    uint16_t found;   // APs the driver reported; found > count means some were dropped
+} wifi_ap_list_t;
+
+/**
+ * @brief Perform a one-shot scan of nearby APs on all channels.
+ *        While associated this is a connected scan: the STA stays up, dwelling
+ *        CONFIG_SCAN_CONNECTED_DWELL_MS per channel and returning to the home
+ *        channel for CONFIG_SCAN_HOME_CHAN_DWELL_MS between channels. Otherwise
+ *        the connection attempt in progress is stopped for the scan and resumed
+ *        after it.
+ * @param[out] out  The filled pool.
+ * @return ESP_OK, or the scan's error (e.g. ESP_ERR_TIMEOUT) with an empty pool.
+ */
+esp_err_t wifi_scan_once(wifi_ap_list_t* out);
+
+#define WIFI_SCAN_MAX_CHANNEL 13
+
+/**
+ * @brief Scan a single channel without disconnecting the STA.
+ *        Starts a non-blocking scan and waits for WIFI_EVENT_SCAN_DONE
+ *        (about one channel dwell, CONFIG_SCAN_CHANNEL_DWELL_MS).
+ * @param      channel  Channel to scan (1..WIFI_SCAN_MAX_CHANNEL).
+ * @param[out] out      The filled pool; empty on error.
  */
-esp_err_t wifi_scan_once(uint16_t* out_count, wifi_ap_record_t** out_info);
+esp_err_t wifi_scan_channel(uint8_t channel, wifi_ap_list_t* out);